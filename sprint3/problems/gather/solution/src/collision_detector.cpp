@@ -1,5 +1,15 @@
 #include "collision_detector.h"
+#include <boost/asio/post.hpp>
 #include <cassert>
+#include <exception>
+#include <iterator>
+#include <latch>
+#include <mutex>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define COLLISION_DETECTOR_X86_SIMD
+#endif
 
 namespace collision_detector {
 
@@ -22,42 +32,429 @@ CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D
     return CollectionResult(sq_distance, proj_ratio);
 }
 
-// В задании на разработку тестов реализовывать следующую функцию не нужно -
-// она будет линковаться извне.
-std::vector<GatheringEvent> FindGatherEvents(
-    const ItemGathererProvider& provider) {
-    std::vector<GatheringEvent> detected_events;
+namespace {
+
+// The kernels repeat the operations of TryCollectPoint in the same order without fused
+// multiply-add, so every lane rounds exactly like the scalar code.
+// Each one handles points [begin, count) as far as whole vectors go and returns where it stopped.
+
+size_t CollectPointsScalar(geom::Point2D a, geom::Point2D b, const double* xs, const double* ys, size_t begin,
+                           size_t count, double* sq_distances, double* proj_ratios) {
+    for (size_t i = begin; i < count; ++i) {
+        const auto result = TryCollectPoint(a, b, geom::Point2D{ xs[i], ys[i] });
+        sq_distances[i] = result.sq_distance;
+        proj_ratios[i] = result.proj_ratio;
+    }
+    return count;
+}
+
+#ifdef COLLISION_DETECTOR_X86_SIMD
+
+size_t CollectPointsSse2(geom::Point2D a, geom::Point2D b, const double* xs, const double* ys, size_t begin,
+                         size_t count, double* sq_distances, double* proj_ratios) {
+    const double v_x = b.x - a.x;
+    const double v_y = b.y - a.y;
+    const __m128d a_x = _mm_set1_pd(a.x);
+    const __m128d a_y = _mm_set1_pd(a.y);
+    const __m128d v_x2 = _mm_set1_pd(v_x);
+    const __m128d v_y2 = _mm_set1_pd(v_y);
+    const __m128d v_len2 = _mm_set1_pd(v_x * v_x + v_y * v_y);
+    size_t i = begin;
+    for (; i + 2 <= count; i += 2) {
+        const __m128d u_x = _mm_sub_pd(_mm_loadu_pd(xs + i), a_x);
+        const __m128d u_y = _mm_sub_pd(_mm_loadu_pd(ys + i), a_y);
+        const __m128d u_dot_v = _mm_add_pd(_mm_mul_pd(u_x, v_x2), _mm_mul_pd(u_y, v_y2));
+        const __m128d u_len2 = _mm_add_pd(_mm_mul_pd(u_x, u_x), _mm_mul_pd(u_y, u_y));
+        _mm_storeu_pd(proj_ratios + i, _mm_div_pd(u_dot_v, v_len2));
+        _mm_storeu_pd(sq_distances + i, _mm_sub_pd(u_len2, _mm_div_pd(_mm_mul_pd(u_dot_v, u_dot_v), v_len2)));
+    }
+    return i;
+}
+
+// Built for AVX2 regardless of the compiler flags, only called after the CPU check below
+__attribute__((target("avx2")))
+size_t CollectPointsAvx2(geom::Point2D a, geom::Point2D b, const double* xs, const double* ys, size_t begin,
+                         size_t count, double* sq_distances, double* proj_ratios) {
+    const double v_x = b.x - a.x;
+    const double v_y = b.y - a.y;
+    const __m256d a_x = _mm256_set1_pd(a.x);
+    const __m256d a_y = _mm256_set1_pd(a.y);
+    const __m256d v_x4 = _mm256_set1_pd(v_x);
+    const __m256d v_y4 = _mm256_set1_pd(v_y);
+    const __m256d v_len2 = _mm256_set1_pd(v_x * v_x + v_y * v_y);
+    size_t i = begin;
+    for (; i + 4 <= count; i += 4) {
+        const __m256d u_x = _mm256_sub_pd(_mm256_loadu_pd(xs + i), a_x);
+        const __m256d u_y = _mm256_sub_pd(_mm256_loadu_pd(ys + i), a_y);
+        const __m256d u_dot_v = _mm256_add_pd(_mm256_mul_pd(u_x, v_x4), _mm256_mul_pd(u_y, v_y4));
+        const __m256d u_len2 = _mm256_add_pd(_mm256_mul_pd(u_x, u_x), _mm256_mul_pd(u_y, u_y));
+        _mm256_storeu_pd(proj_ratios + i, _mm256_div_pd(u_dot_v, v_len2));
+        _mm256_storeu_pd(sq_distances + i, _mm256_sub_pd(u_len2, _mm256_div_pd(_mm256_mul_pd(u_dot_v, u_dot_v), v_len2)));
+    }
+    return i;
+}
+
+bool HasAvx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+
+#endif
+
+}  // namespace
+
+void TryCollectPoints(geom::Point2D a, geom::Point2D b, std::span<const double> xs, std::span<const double> ys,
+                      std::span<double> sq_distances, std::span<double> proj_ratios) {
+    assert(b.x != a.x || b.y != a.y);
+    assert(ys.size() == xs.size() && sq_distances.size() == xs.size() && proj_ratios.size() == xs.size());
+    const size_t count = xs.size();
+    size_t done = 0;
+#ifdef COLLISION_DETECTOR_X86_SIMD
+    if (HasAvx2()) {
+        done = CollectPointsAvx2(a, b, xs.data(), ys.data(), done, count, sq_distances.data(), proj_ratios.data());
+    }
+    done = CollectPointsSse2(a, b, xs.data(), ys.data(), done, count, sq_distances.data(), proj_ratios.data());
+#endif
+    CollectPointsScalar(a, b, xs.data(), ys.data(), done, count, sq_distances.data(), proj_ratios.data());
+}
+
+namespace {
+
+// Candidate items of one gatherer as separate arrays for TryCollectPoints
+struct ItemBatch {
+    void Clear() {
+        xs.clear();
+        ys.clear();
+        widths.clear();
+    }
+    void Add(const Item& item) {
+        xs.push_back(item.position.x);
+        ys.push_back(item.position.y);
+        widths.push_back(item.width);
+    }
+    void Collect(const Gatherer& gatherer) {
+        sq_distances.resize(xs.size());
+        proj_ratios.resize(xs.size());
+        TryCollectPoints(gatherer.start_pos, gatherer.end_pos, xs, ys, sq_distances, proj_ratios);
+    }
+
+    std::vector<double> xs;
+    std::vector<double> ys;
+    std::vector<double> widths;
+    std::vector<double> sq_distances;
+    std::vector<double> proj_ratios;
+};
+
+// Below this amount of items a plain scan is cheaper than building the grid.
+constexpr size_t BROAD_PHASE_MIN_ITEMS = 32;
+// Fewer candidates than one AVX2 vector go through TryCollectPoint one by one.
+constexpr size_t BATCH_MIN_ITEMS = 4;
+constexpr double GRID_CELL_SIZE = 1.0;
+
+}  // namespace
+
+ItemGrid::ItemGrid(double cell_size) : cell_size_(cell_size) {}
+
+void ItemGrid::Insert(size_t idx, geom::Point2D pos) {
+    cells_[KeyOf(CellOf(pos.x), CellOf(pos.y))].push_back(idx);
+}
+
+void ItemGrid::Erase(size_t idx, geom::Point2D pos) {
+    auto it = cells_.find(KeyOf(CellOf(pos.x), CellOf(pos.y)));
+    if (it == cells_.end()) {
+        return;
+    }
+    auto& cell = it->second;
+    if (auto found = std::find(cell.begin(), cell.end(), idx); found != cell.end()) {
+        *found = cell.back();
+        cell.pop_back();
+    }
+    if (cell.empty()) {
+        cells_.erase(it);
+    }
+}
+
+void ItemGrid::Clear() {
+    cells_.clear();
+}
+
+LaneIndex::LaneIndex(double lane_width) : lane_width_(lane_width) {}
 
+void LaneIndex::Insert(size_t idx, geom::Point2D pos) {
+    Insert(horizontal_, pos.y, Entry{ pos.x, idx });
+    Insert(vertical_, pos.x, Entry{ pos.y, idx });
+}
+
+void LaneIndex::Erase(size_t idx, geom::Point2D pos) {
+    Erase(horizontal_, pos.y, Entry{ pos.x, idx });
+    Erase(vertical_, pos.x, Entry{ pos.y, idx });
+}
+
+void LaneIndex::Clear() {
+    horizontal_.clear();
+    vertical_.clear();
+}
+
+void LaneIndex::Insert(Lanes& lanes, double across, Entry entry) const {
+    auto& entries = lanes[LaneOf(across)];
+    entries.insert(std::upper_bound(entries.begin(), entries.end(), entry), entry);
+}
+
+void LaneIndex::Erase(Lanes& lanes, double across, Entry entry) const {
+    auto lane = lanes.find(LaneOf(across));
+    if (lane == lanes.end()) {
+        return;
+    }
+    auto& entries = lane->second;
+    if (auto it = std::lower_bound(entries.begin(), entries.end(), entry);
+        it != entries.end() && it->along == entry.along && it->idx == entry.idx) {
+        entries.erase(it);
+    }
+    if (entries.empty()) {
+        lanes.erase(lane);
+    }
+}
+
+namespace {
+
+// Narrow phase for every moving gatherer in [gatherers_begin, gatherers_end) against the items the broad
+// phase finds near its path, events are appended to detected_events unsorted.
+// near(gatherer, reach, candidates) fills candidates and returns false when it cannot cull, then all
+// items_count items are checked. item_at(i) returns item i, gatherer_at(g) returns gatherer g.
+template <typename Near, typename ItemAt, typename GathererAt>
+void DetectEvents(size_t gatherers_begin, size_t gatherers_end, size_t items_count, double max_item_width,
+                  const Near& near, const ItemAt& item_at, const GathererAt& gatherer_at,
+                  std::vector<GatheringEvent>& detected_events) {
     static auto eq_pt = [](geom::Point2D p1, geom::Point2D p2) { // check points equality lambda
         return p1.x == p2.x && p1.y == p2.y;
     };
 
-    for (size_t g = 0; g < provider.GatherersCount(); ++g) { // browse through gatherers
-        Gatherer gatherer = provider.GetGatherer(g); // get gatherer by index in vector
+    std::vector<size_t> candidates;
+    ItemBatch batch;
+    for (size_t g = gatherers_begin; g < gatherers_end; ++g) { // browse through gatherers
+        const Gatherer gatherer = gatherer_at(g); // get gatherer by index in vector
         if (eq_pt(gatherer.start_pos, gatherer.end_pos)) { // ignore stationary gatherer case
             continue;
         }
-        for (size_t i = 0; i < provider.ItemsCount(); ++i) { // browse through items
-            Item item = provider.GetItem(i); // get item by index in vector
-            auto collect_result
-                = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position); // try collect point
 
-            if (collect_result.IsCollected(gatherer.width + item.width)) { // if succeeded
+        candidates.clear(); // items near the gatherer's path (broad phase)
+        // a handful of items is scanned faster than looked up, whatever the broad phase
+        const bool culled = items_count >= BROAD_PHASE_MIN_ITEMS && near(gatherer, gatherer.width + max_item_width, candidates);
+        if (!culled) {
+            candidates.resize(items_count);
+            for (size_t i = 0; i < items_count; ++i) {
+                candidates[i] = i;
+            }
+        }
+
+        const auto report = [&detected_events, &gatherer, g](size_t i, CollectionResult collect_result, double item_width) {
+            if (collect_result.IsCollected(gatherer.width + item_width)) { // if succeeded
                 GatheringEvent evt{.item_id = i,
                                    .gatherer_id = g,
                                    .sq_distance = collect_result.sq_distance,
                                    .time = collect_result.proj_ratio}; // form event
                 detected_events.push_back(evt); // add event
             }
+        };
+
+        if (candidates.size() < BATCH_MIN_ITEMS) { // filling the batch would cost more than it saves
+            for (size_t i : candidates) {
+                const Item item = item_at(i);
+                report(i, TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position), item.width);
+            }
+            continue;
+        }
+
+        batch.Clear();
+        for (size_t i : candidates) { // fetch candidate items
+            batch.Add(item_at(i));
+        }
+        batch.Collect(gatherer); // try collect points, whole batch at once (narrow phase)
+
+        for (size_t k = 0; k < candidates.size(); ++k) { // browse through candidate items
+            report(candidates[k], CollectionResult{ batch.sq_distances[k], batch.proj_ratios[k] }, batch.widths[k]);
         }
     }
+}
 
-    std::sort(detected_events.begin(), detected_events.end(),
-              [](const GatheringEvent& e_l, const GatheringEvent& e_r) {
-                  return e_l.time < e_r.time;
-              }); // sort events in chronological order
+bool EventBefore(const GatheringEvent& e_l, const GatheringEvent& e_r) {
+    if (e_l.time != e_r.time) {
+        return e_l.time < e_r.time;
+    }
+    if (e_l.gatherer_id != e_r.gatherer_id) {
+        return e_l.gatherer_id < e_r.gatherer_id;
+    }
+    return e_l.item_id < e_r.item_id;
+}
 
+template <typename Near, typename ItemAt, typename GathererAt>
+std::vector<GatheringEvent> FindEvents(size_t items_count, size_t gatherers_count, double max_item_width,
+                                       const Near& near, const ItemAt& item_at, const GathererAt& gatherer_at) {
+    std::vector<GatheringEvent> detected_events;
+    DetectEvents(0, gatherers_count, items_count, max_item_width, near, item_at, gatherer_at, detected_events);
+    std::sort(detected_events.begin(), detected_events.end(), EventBefore); // sort events in chronological order
     return detected_events; // return result
 }
 
+// Merges sorted parts pairwise. (gatherer, item) pairs are unique, so EventBefore is a strict total
+// order on events and the result is exactly what sorting them all at once gives.
+std::vector<GatheringEvent> MergeEvents(std::vector<std::vector<GatheringEvent>> parts) {
+    while (parts.size() > 1) {
+        std::vector<std::vector<GatheringEvent>> merged;
+        merged.reserve((parts.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < parts.size(); i += 2) {
+            std::vector<GatheringEvent> events;
+            events.reserve(parts[i].size() + parts[i + 1].size());
+            std::merge(parts[i].begin(), parts[i].end(), parts[i + 1].begin(), parts[i + 1].end(),
+                       std::back_inserter(events), EventBefore);
+            merged.push_back(std::move(events));
+        }
+        if (parts.size() % 2 == 1) {
+            merged.push_back(std::move(parts.back()));
+        }
+        parts = std::move(merged);
+    }
+    return parts.empty() ? std::vector<GatheringEvent>{} : std::move(parts.front());
+}
+
+// FindEvents with gatherers split into contiguous parts that are searched and sorted on pool.
+// near, item_at and gatherer_at are called from several threads at once.
+template <typename Near, typename ItemAt, typename GathererAt>
+std::vector<GatheringEvent> FindEventsParallel(size_t items_count, size_t gatherers_count, double max_item_width,
+                                               const Near& near, const ItemAt& item_at, const GathererAt& gatherer_at,
+                                               boost::asio::thread_pool& pool, unsigned threads) {
+    if (threads < 2 || gatherers_count < PARALLEL_MIN_GATHERERS) {
+        return FindEvents(items_count, gatherers_count, max_item_width, near, item_at, gatherer_at);
+    }
+
+    const size_t parts_count = std::min<size_t>(threads, gatherers_count);
+    std::vector<std::vector<GatheringEvent>> parts(parts_count); // per-thread buffers
+    std::latch done(static_cast<std::ptrdiff_t>(parts_count));
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    for (size_t p = 0; p < parts_count; ++p) {
+        boost::asio::post(pool, [&, p]() {
+            try {
+                DetectEvents(gatherers_count * p / parts_count, gatherers_count * (p + 1) / parts_count, items_count,
+                             max_item_width, near, item_at, gatherer_at, parts[p]);
+                std::sort(parts[p].begin(), parts[p].end(), EventBefore);
+            } catch (...) {
+                std::lock_guard lock{ error_mutex };
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            done.count_down();
+        });
+    }
+    done.wait();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return MergeEvents(std::move(parts));
+}
+
+// Broad phase over grid, gives up on boxes wider than items_count cells or without a grid
+auto GridNear(const ItemGrid* grid, size_t items_count) {
+    return [grid, items_count](const Gatherer& gatherer, double reach, std::vector<size_t>& candidates) {
+        return grid && grid->ForEachNear(gatherer.start_pos, gatherer.end_pos, reach, items_count,
+                                         [&candidates](size_t idx) { candidates.push_back(idx); });
+    };
+}
+
+// Broad phase over lanes, gives up on moves that are not axis-parallel
+auto LaneNear(const LaneIndex& lanes) {
+    return [&lanes](const Gatherer& gatherer, double reach, std::vector<size_t>& candidates) {
+        return lanes.ForEachNear(gatherer.start_pos, gatherer.end_pos, reach,
+                                 [&candidates](size_t idx) { candidates.push_back(idx); });
+    };
+}
+
+// Direct access to contiguous arrays, no virtual calls in the loops
+auto ItemsAt(std::span<const Item> items) {
+    return [items](size_t i) { return items[i]; };
+}
+auto GatherersAt(std::span<const Gatherer> gatherers) {
+    return [gatherers](size_t g) { return gatherers[g]; };
+}
+
+auto ItemsAt(const ItemGathererProvider& provider) {
+    return [&provider](size_t i) { return provider.GetItem(i); };
+}
+auto GatherersAt(const ItemGathererProvider& provider) {
+    return [&provider](size_t g) { return provider.GetGatherer(g); };
+}
+
+}  // namespace
+
+// В задании на разработку тестов реализовывать следующую функцию не нужно -
+// она будет линковаться извне.
+std::vector<GatheringEvent> FindGatherEvents(
+    const ItemGathererProvider& provider) {
+    std::vector<Item> items; // fetch every item and gatherer once instead of once per pair
+    items.reserve(provider.ItemsCount());
+    for (size_t i = 0; i < provider.ItemsCount(); ++i) {
+        items.push_back(provider.GetItem(i));
+    }
+    std::vector<Gatherer> gatherers;
+    gatherers.reserve(provider.GatherersCount());
+    for (size_t g = 0; g < provider.GatherersCount(); ++g) {
+        gatherers.push_back(provider.GetGatherer(g));
+    }
+    return FindGatherEvents(items, gatherers);
+}
+
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers) {
+    double max_item_width = 0.0;
+    for (const Item& item : items) {
+        max_item_width = std::max(max_item_width, item.width);
+    }
+
+    const bool use_grid = items.size() >= BROAD_PHASE_MIN_ITEMS;
+    ItemGrid grid(GRID_CELL_SIZE);
+    if (use_grid) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            grid.Insert(i, items[i].position);
+        }
+    }
+    return FindEvents(items.size(), gatherers.size(), max_item_width, GridNear(use_grid ? &grid : nullptr, items.size()),
+                      ItemsAt(items), GatherersAt(gatherers));
+}
+
+std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider, const ItemGrid& grid, double max_item_width) {
+    return FindEvents(provider.ItemsCount(), provider.GatherersCount(), max_item_width,
+                      GridNear(&grid, provider.ItemsCount()), ItemsAt(provider), GatherersAt(provider));
+}
+
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers,
+                                             const ItemGrid& grid, double max_item_width) {
+    return FindEvents(items.size(), gatherers.size(), max_item_width, GridNear(&grid, items.size()),
+                      ItemsAt(items), GatherersAt(gatherers));
+}
+
+std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider, const LaneIndex& lanes, double max_item_width) {
+    return FindEvents(provider.ItemsCount(), provider.GatherersCount(), max_item_width,
+                      LaneNear(lanes), ItemsAt(provider), GatherersAt(provider));
+}
+
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers,
+                                             const LaneIndex& lanes, double max_item_width) {
+    return FindEvents(items.size(), gatherers.size(), max_item_width, LaneNear(lanes),
+                      ItemsAt(items), GatherersAt(gatherers));
+}
+
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers,
+                                             const ItemGrid& grid, double max_item_width,
+                                             boost::asio::thread_pool& pool, unsigned threads) {
+    return FindEventsParallel(items.size(), gatherers.size(), max_item_width, GridNear(&grid, items.size()),
+                              ItemsAt(items), GatherersAt(gatherers), pool, threads);
+}
+
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers,
+                                             const LaneIndex& lanes, double max_item_width,
+                                             boost::asio::thread_pool& pool, unsigned threads) {
+    return FindEventsParallel(items.size(), gatherers.size(), max_item_width, LaneNear(lanes),
+                              ItemsAt(items), GatherersAt(gatherers), pool, threads);
+}
+
 }  // namespace collision_detector
\ No newline at end of file
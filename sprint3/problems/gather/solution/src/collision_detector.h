@@ -2,7 +2,13 @@
 
 #include "geom.h"
 
+#include <boost/asio/thread_pool.hpp>
+
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 namespace collision_detector {
@@ -23,6 +29,12 @@ struct CollectionResult {
 // Эта функция реализована в уроке.
 CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D c);
 
+// TryCollectPoint for a batch of points c_i = (xs[i], ys[i]), results go to sq_distances[i] and
+// proj_ratios[i]; all spans have the same size. Uses AVX2 or SSE2 when the CPU has them,
+// the results are bit-identical to TryCollectPoint either way.
+void TryCollectPoints(geom::Point2D a, geom::Point2D b, std::span<const double> xs, std::span<const double> ys,
+                      std::span<double> sq_distances, std::span<double> proj_ratios);
+
 struct Item {
     geom::Point2D position;
     double width;
@@ -45,6 +57,125 @@ public:
     virtual Gatherer GetGatherer(size_t idx) const = 0;
 };
 
+// Uniform grid over item positions (broad phase).
+// Only items from cells touched by the widened bounding box of a gatherer's
+// move are handed over to TryCollectPoint.
+class ItemGrid {
+public:
+    explicit ItemGrid(double cell_size);
+    void Insert(size_t idx, geom::Point2D pos);
+    // pos has to be the position idx was inserted with
+    void Erase(size_t idx, geom::Point2D pos);
+    void Clear();
+    size_t CellsCount() const { return cells_.size(); }
+
+    // Calls fn(idx) for every item whose cell intersects the box around segment ab
+    // widened by reach. Returns false without calling fn if the box covers more
+    // than max_cells cells, so the caller can fall back to a plain scan.
+    template <typename Fn>
+    bool ForEachNear(geom::Point2D a, geom::Point2D b, double reach, size_t max_cells, Fn&& fn) const {
+        const std::int64_t min_cx = CellOf(std::min(a.x, b.x) - reach);
+        const std::int64_t max_cx = CellOf(std::max(a.x, b.x) + reach);
+        const std::int64_t min_cy = CellOf(std::min(a.y, b.y) - reach);
+        const std::int64_t max_cy = CellOf(std::max(a.y, b.y) + reach);
+        if (static_cast<double>(max_cx - min_cx + 1) * static_cast<double>(max_cy - min_cy + 1) > static_cast<double>(max_cells)) {
+            return false;
+        }
+        for (std::int64_t cx = min_cx; cx <= max_cx; ++cx) {
+            for (std::int64_t cy = min_cy; cy <= max_cy; ++cy) {
+                if (auto it = cells_.find(KeyOf(cx, cy)); it != cells_.end()) {
+                    for (size_t idx : it->second) {
+                        fn(idx);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    using CellKey = std::uint64_t;
+
+    std::int64_t CellOf(double coord) const {
+        return static_cast<std::int64_t>(std::floor(coord / cell_size_));
+    }
+    static CellKey KeyOf(std::int64_t cx, std::int64_t cy) {
+        return (static_cast<CellKey>(static_cast<std::uint32_t>(cx)) << 32) | static_cast<std::uint32_t>(cy);
+    }
+
+    double cell_size_;
+    std::unordered_map<CellKey, std::vector<size_t>> cells_;
+};
+
+// Items bucketed into axis-parallel lanes lane_width wide (broad phase for movement along roads).
+// Every item sits in the horizontal lane of its y, sorted by x, and in the vertical lane
+// of its x, sorted by y. A horizontal or vertical move then becomes a binary searched
+// interval query on the few lanes within reach of its line.
+class LaneIndex {
+public:
+    explicit LaneIndex(double lane_width);
+    void Insert(size_t idx, geom::Point2D pos);
+    // pos has to be the position idx was inserted with
+    void Erase(size_t idx, geom::Point2D pos);
+    void Clear();
+
+    // Calls fn(idx) for every item within reach of segment ab along both axes.
+    // Returns false without calling fn if ab is not axis-parallel.
+    template <typename Fn>
+    bool ForEachNear(geom::Point2D a, geom::Point2D b, double reach, Fn&& fn) const {
+        if (a.y == b.y) {
+            ForEachInRange(horizontal_, a.y, std::min(a.x, b.x), std::max(a.x, b.x), reach, fn);
+            return true;
+        }
+        if (a.x == b.x) {
+            ForEachInRange(vertical_, a.x, std::min(a.y, b.y), std::max(a.y, b.y), reach, fn);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Entry {
+        double along;  // coordinate along the lane
+        size_t idx;
+
+        bool operator<(const Entry& other) const {
+            return along != other.along ? along < other.along : idx < other.idx;
+        }
+    };
+    // lane number across the lanes -> entries sorted by the coordinate along them
+    using Lanes = std::unordered_map<std::int64_t, std::vector<Entry>>;
+
+    std::int64_t LaneOf(double across) const {
+        return static_cast<std::int64_t>(std::floor(across / lane_width_));
+    }
+    void Insert(Lanes& lanes, double across, Entry entry) const;
+    void Erase(Lanes& lanes, double across, Entry entry) const;
+
+    template <typename Fn>
+    void ForEachInRange(const Lanes& lanes, double across, double from, double to, double reach, Fn& fn) const {
+        reach += QUERY_SLACK * (1.0 + reach);  // keeps items the narrow phase may accept through rounding
+        for (std::int64_t lane = LaneOf(across - reach); lane <= LaneOf(across + reach); ++lane) {
+            auto found = lanes.find(lane);
+            if (found == lanes.end()) {
+                continue;
+            }
+            const auto& entries = found->second;
+            auto it = std::lower_bound(entries.begin(), entries.end(), from - reach,
+                                       [](const Entry& e, double value) { return e.along < value; });
+            for (; it != entries.end() && it->along <= to + reach; ++it) {
+                fn(it->idx);
+            }
+        }
+    }
+
+    static constexpr double QUERY_SLACK = 1e-9;
+
+    double lane_width_;
+    Lanes horizontal_;  // by y, sorted by x
+    Lanes vertical_;    // by x, sorted by y
+};
+
 struct GatheringEvent {
     size_t item_id;
     size_t gatherer_id;
@@ -54,6 +185,34 @@ struct GatheringEvent {
 
 // Эту функцию вам нужно будет реализовать в соответствующем задании.
 // При проверке ваших тестов она не нужна - функция будет линковаться снаружи.
+// Events are ordered by time; ties are broken by gatherer and then by item index.
 std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
+// Same events, for providers that keep their items in grid across calls. Every item index of the
+// provider has to be in grid, max_item_width bounds the widths of all items.
+std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider, const ItemGrid& grid, double max_item_width);
+// Same events, for providers whose gatherers move along roads. Axis-parallel moves only look at the
+// lanes around them, other moves check every item. Every item index of the provider has to be in lanes.
+std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider, const LaneIndex& lanes, double max_item_width);
+
+// The same three searches over contiguous arrays: item and gatherer indices are positions in items and
+// gatherers. Nothing is called through ItemGathererProvider, so the loops inline and vectorize.
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers);
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers,
+                                             const ItemGrid& grid, double max_item_width);
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers,
+                                             const LaneIndex& lanes, double max_item_width);
+
+// Below this amount of gatherers the parallel searches stay on the calling thread.
+constexpr size_t PARALLEL_MIN_GATHERERS = 2048;
+
+// Parallel array searches: gatherers are split into threads contiguous parts searched on pool, the
+// calling thread waits and merges the parts into exactly the events the serial search returns.
+// pool must not be the pool running the call.
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers,
+                                             const ItemGrid& grid, double max_item_width,
+                                             boost::asio::thread_pool& pool, unsigned threads);
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers,
+                                             const LaneIndex& lanes, double max_item_width,
+                                             boost::asio::thread_pool& pool, unsigned threads);
 
 }  // namespace collision_detector
\ No newline at end of file
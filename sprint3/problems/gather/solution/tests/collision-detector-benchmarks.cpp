@@ -0,0 +1,75 @@
+#include "road-scene.h"
+#include <boost/asio/thread_pool.hpp>
+#include <string>
+#include <thread>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+// Hidden from the default run, start with: collision_detection_tests "[benchmark]"
+
+TEST_CASE("Many items per road", "[.][benchmark]") {
+	// 12 roads of 50 units, 40000 items, moves as long as one tick of a fast dog
+	RoadScene scene(5, 40000, 2000, 1, 0.3);
+	const auto grid = scene.BuildGrid();
+	const auto lanes = scene.BuildLanes();
+
+	BENCHMARK("generic") {
+		return collision_detector::FindGatherEvents(scene);
+	};
+	BENCHMARK("prebuilt grid") {
+		return collision_detector::FindGatherEvents(scene, grid, scene.MaxItemWidth());
+	};
+	BENCHMARK("prebuilt lanes") {
+		return collision_detector::FindGatherEvents(scene, lanes, scene.MaxItemWidth());
+	};
+	BENCHMARK("prebuilt lanes, arrays") {
+		return collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), lanes, scene.MaxItemWidth());
+	};
+}
+
+TEST_CASE("Narrow phase over one batch", "[.][benchmark]") {
+	RoadScene scene(5, 4096, 1, 2);
+	std::vector<double> xs;
+	std::vector<double> ys;
+	for (size_t i = 0; i < scene.ItemsCount(); ++i)
+	{
+		xs.push_back(scene.GetItem(i).position.x);
+		ys.push_back(scene.GetItem(i).position.y);
+	}
+	const geom::Point2D a{ 10.0, 20.2 };
+	const geom::Point2D b{ 12.0, 20.2 };
+	std::vector<double> sq_distances(xs.size());
+	std::vector<double> proj_ratios(xs.size());
+
+	BENCHMARK("one by one") {
+		for (size_t i = 0; i < xs.size(); ++i)
+		{
+			const auto result = collision_detector::TryCollectPoint(a, b, geom::Point2D{ xs[i], ys[i] });
+			sq_distances[i] = result.sq_distance;
+			proj_ratios[i] = result.proj_ratio;
+		}
+		return proj_ratios.back();
+	};
+	BENCHMARK("batched") {
+		collision_detector::TryCollectPoints(a, b, xs, ys, sq_distances, proj_ratios);
+		return proj_ratios.back();
+	};
+}
+
+TEST_CASE("Parallel scaling", "[.][benchmark]") {
+	// one big session: 40000 dogs walking among 40000 items
+	RoadScene scene(10, 40000, 40000, 3, 0.3);
+	const auto lanes = scene.BuildLanes();
+	const unsigned max_threads = std::max(std::thread::hardware_concurrency(), 2u);
+	boost::asio::thread_pool pool(max_threads);
+
+	BENCHMARK("serial") {
+		return collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), lanes, scene.MaxItemWidth());
+	};
+	for (unsigned threads = 2; threads <= max_threads; threads *= 2)
+	{
+		BENCHMARK(std::to_string(threads) + " threads") {
+			return collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), lanes, scene.MaxItemWidth(), pool, threads);
+		};
+	}
+}
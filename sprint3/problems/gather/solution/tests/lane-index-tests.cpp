@@ -0,0 +1,53 @@
+#include "road-scene.h"
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+	const std::string LaneIndexTag = "[LaneIndex]";
+}
+
+TEST_CASE("Lanes find the same events as the generic detector", LaneIndexTag) {
+	for (unsigned seed = 0; seed < 20; ++seed)
+	{
+		RoadScene scene(5, 500, 200, seed);
+		const auto expected = collision_detector::FindGatherEvents(scene);
+		REQUIRE_FALSE(expected.empty());
+		CHECK(SameEvents(collision_detector::FindGatherEvents(scene, scene.BuildLanes(), scene.MaxItemWidth()), expected));
+	}
+}
+
+TEST_CASE("Lanes fall back to every item for moves off the axes", LaneIndexTag) {
+	RoadScene scene(3, 300, 10, 7);
+	scene.AddDiagonalGatherer();
+	CHECK(SameEvents(collision_detector::FindGatherEvents(scene, scene.BuildLanes(), scene.MaxItemWidth()),
+		collision_detector::FindGatherEvents(scene)));
+}
+
+TEST_CASE("Erased items are not gathered", LaneIndexTag) {
+	RoadScene scene(3, 300, 100, 11);
+	auto lanes = scene.BuildLanes();
+	const auto all_events = collision_detector::FindGatherEvents(scene, lanes, scene.MaxItemWidth());
+	REQUIRE_FALSE(all_events.empty());
+
+	const size_t erased = all_events.front().item_id;
+	lanes.Erase(erased, scene.GetItem(erased).position);
+	for (const auto& event : collision_detector::FindGatherEvents(scene, lanes, scene.MaxItemWidth()))
+	{
+		CHECK(event.item_id != erased);
+	}
+
+	lanes.Insert(erased, scene.GetItem(erased).position);
+	CHECK(SameEvents(collision_detector::FindGatherEvents(scene, lanes, scene.MaxItemWidth()), all_events));
+}
+
+TEST_CASE("Arrays find the same events as the provider", LaneIndexTag) {
+	RoadScene scene(5, 500, 200, 3);
+	scene.AddDiagonalGatherer();
+	const auto lanes = scene.BuildLanes();
+	const auto grid = scene.BuildGrid();
+	CHECK(SameEvents(collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers()),
+		collision_detector::FindGatherEvents(scene)));
+	CHECK(SameEvents(collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), grid, scene.MaxItemWidth()),
+		collision_detector::FindGatherEvents(scene, grid, scene.MaxItemWidth())));
+	CHECK(SameEvents(collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), lanes, scene.MaxItemWidth()),
+		collision_detector::FindGatherEvents(scene, lanes, scene.MaxItemWidth())));
+}
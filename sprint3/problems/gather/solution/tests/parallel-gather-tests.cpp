@@ -0,0 +1,37 @@
+#include "road-scene.h"
+#include <boost/asio/thread_pool.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+	const std::string ParallelTag = "[Parallel]";
+}
+
+TEST_CASE("Parallel search returns exactly the serial events", ParallelTag) {
+	boost::asio::thread_pool pool(4);
+	RoadScene scene(5, 5000, collision_detector::PARALLEL_MIN_GATHERERS * 2, 8);
+	scene.AddDiagonalGatherer();
+	const auto lanes = scene.BuildLanes();
+	const auto grid = scene.BuildGrid();
+	const auto expected = collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), lanes, scene.MaxItemWidth());
+	REQUIRE_FALSE(expected.empty());
+
+	// part counts that do and do not divide the gatherers evenly, more parts than pool threads too
+	for (unsigned threads : { 2u, 3u, 4u, 7u, 16u })
+	{
+		CHECK(SameEvents(collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), lanes, scene.MaxItemWidth(), pool, threads),
+			expected));
+		CHECK(SameEvents(collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), grid, scene.MaxItemWidth(), pool, threads),
+			expected));
+	}
+}
+
+TEST_CASE("Small sessions and single threads stay serial", ParallelTag) {
+	boost::asio::thread_pool pool(2);
+	RoadScene scene(3, 300, collision_detector::PARALLEL_MIN_GATHERERS - 1, 9);
+	const auto lanes = scene.BuildLanes();
+	const auto expected = collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), lanes, scene.MaxItemWidth());
+	CHECK(SameEvents(collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), lanes, scene.MaxItemWidth(), pool, 2),
+		expected));
+	CHECK(SameEvents(collision_detector::FindGatherEvents(scene.Items(), scene.Gatherers(), lanes, scene.MaxItemWidth(), pool, 1),
+		expected));
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../src/collision_detector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Random town for tests and benchmarks: a square of horizontal and vertical roads,
+// items lying on them as in the game and gatherers walking along them within the road width.
+class RoadScene : public collision_detector::ItemGathererProvider {
+public:
+	static constexpr double road_offset = 0.4;
+	static constexpr double item_width = 0.0;
+	static constexpr double base_width = 0.25;
+	static constexpr double gatherer_width = 0.3;
+
+	// Gatherers move up to max_step along their road
+	RoadScene(int roads_per_axis, size_t items_count, size_t gatherers_count, unsigned seed, double max_step = 3.0)
+		: random_(seed)
+		, size_(roads_per_axis * road_step) {
+		for (size_t i = 0; i < items_count; ++i)
+		{
+			// every tenth item stands for an office, they are wider
+			items_.push_back({ RandomRoadPoint(roads_per_axis), i % 10 == 0 ? base_width : item_width });
+		}
+		std::uniform_real_distribution<double> lateral(-road_offset, road_offset);
+		std::uniform_real_distribution<double> step(-max_step, max_step);
+		for (size_t i = 0; i < gatherers_count; ++i)
+		{
+			geom::Point2D start = RandomRoadPoint(roads_per_axis);
+			geom::Point2D end = start;
+			if (random_() % 2 == 0)
+			{
+				start.y += lateral(random_);
+				end = { std::clamp(start.x + step(random_), -road_offset, size_ + road_offset), start.y };
+			}
+			else
+			{
+				start.x += lateral(random_);
+				end = { start.x, std::clamp(start.y + step(random_), -road_offset, size_ + road_offset) };
+			}
+			gatherers_.push_back({ start, end, gatherer_width });
+		}
+	}
+
+	// Adds a gatherer crossing the town diagonally
+	void AddDiagonalGatherer() {
+		gatherers_.push_back({ geom::Point2D{ 0.0, 0.0 }, geom::Point2D{ size_, size_ }, gatherer_width });
+	}
+
+	size_t ItemsCount() const override {
+		return items_.size();
+	}
+	collision_detector::Item GetItem(size_t idx) const override {
+		return items_[idx];
+	}
+	size_t GatherersCount() const override {
+		return gatherers_.size();
+	}
+	collision_detector::Gatherer GetGatherer(size_t idx) const override {
+		return gatherers_[idx];
+	}
+
+	const std::vector<collision_detector::Item>& Items() const {
+		return items_;
+	}
+	const std::vector<collision_detector::Gatherer>& Gatherers() const {
+		return gatherers_;
+	}
+	double MaxItemWidth() const {
+		return base_width;
+	}
+	collision_detector::ItemGrid BuildGrid() const {
+		collision_detector::ItemGrid grid(1.0);
+		for (size_t i = 0; i < items_.size(); ++i)
+		{
+			grid.Insert(i, items_[i].position);
+		}
+		return grid;
+	}
+	collision_detector::LaneIndex BuildLanes() const {
+		collision_detector::LaneIndex lanes(1.0);
+		for (size_t i = 0; i < items_.size(); ++i)
+		{
+			lanes.Insert(i, items_[i].position);
+		}
+		return lanes;
+	}
+
+private:
+	static constexpr int road_step = 10;
+
+	geom::Point2D RandomRoadPoint(int roads_per_axis) {
+		std::uniform_int_distribution<int> road(0, roads_per_axis);
+		std::uniform_real_distribution<double> along(0.0, size_);
+		const double across = road(random_) * road_step;
+		const double value = std::round(along(random_) * 10) / 10;
+		return random_() % 2 == 0 ? geom::Point2D{ value, across } : geom::Point2D{ across, value };
+	}
+
+	std::mt19937 random_;
+	double size_;
+	std::vector<collision_detector::Item> items_;
+	std::vector<collision_detector::Gatherer> gatherers_;
+};
+
+inline bool SameEvents(const std::vector<collision_detector::GatheringEvent>& lhs,
+                       const std::vector<collision_detector::GatheringEvent>& rhs) {
+	return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const auto& l, const auto& r) {
+		return l.item_id == r.item_id && l.gatherer_id == r.gatherer_id && l.sq_distance == r.sq_distance && l.time == r.time;
+	});
+}
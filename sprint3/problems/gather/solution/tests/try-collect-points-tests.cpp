@@ -0,0 +1,65 @@
+#include "../src/collision_detector.h"
+#include <random>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+	const std::string TryCollectPointsTag = "[TryCollectPoints]";
+
+	// Checks every point of the batch bit for bit against TryCollectPoint
+	void CheckAgreement(geom::Point2D a, geom::Point2D b, const std::vector<double>& xs, const std::vector<double>& ys) {
+		std::vector<double> sq_distances(xs.size());
+		std::vector<double> proj_ratios(xs.size());
+		collision_detector::TryCollectPoints(a, b, xs, ys, sq_distances, proj_ratios);
+		for (size_t i = 0; i < xs.size(); ++i)
+		{
+			const auto expected = collision_detector::TryCollectPoint(a, b, geom::Point2D{ xs[i], ys[i] });
+			CHECK(sq_distances[i] == expected.sq_distance);
+			CHECK(proj_ratios[i] == expected.proj_ratio);
+		}
+	}
+}
+
+TEST_CASE("Batch agrees with TryCollectPoint for every batch size", TryCollectPointsTag) {
+	std::mt19937 random(5);
+	std::uniform_real_distribution<double> coord(-100.0, 100.0);
+	// sizes around the vector widths exercise the scalar tails
+	for (size_t size = 0; size <= 19; ++size)
+	{
+		std::vector<double> xs;
+		std::vector<double> ys;
+		for (size_t i = 0; i < size; ++i)
+		{
+			xs.push_back(coord(random));
+			ys.push_back(coord(random));
+		}
+		CheckAgreement({ coord(random), coord(random) }, { coord(random), coord(random) }, xs, ys);
+	}
+}
+
+TEST_CASE("Batch agrees with TryCollectPoint on roads", TryCollectPointsTag) {
+	std::mt19937 random(6);
+	std::uniform_real_distribution<double> along(0.0, 50.0);
+	std::uniform_real_distribution<double> lateral(-0.4, 0.4);
+	for (int round = 0; round < 100; ++round)
+	{
+		std::vector<double> xs;
+		std::vector<double> ys;
+		for (int i = 0; i < 37; ++i)
+		{
+			// items on a horizontal road, some at the very ends of the move
+			xs.push_back(i % 9 == 0 ? 10.0 : std::round(along(random) * 10) / 10);
+			ys.push_back(20.0);
+		}
+		const double y = 20.0 + lateral(random);
+		CheckAgreement({ 10.0, y }, { 10.0 + along(random) / 10 + 0.1, y }, xs, ys);
+		CheckAgreement({ 40.0, y }, { 10.0, y }, xs, ys);
+	}
+}
+
+TEST_CASE("Tiny moves are not lost in the batch", TryCollectPointsTag) {
+	const std::vector<double> xs{ 1.0, 1.0 + 1e-12, 1.0 - 1e-12, 0.5, 2.0 };
+	const std::vector<double> ys{ 1.0, 1.0, 1.0, 1.0, 1.0 };
+	CheckAgreement({ 1.0, 1.0 }, { 1.0 + 1e-12, 1.0 }, xs, ys);
+	CheckAgreement({ 1.0, 1.0 }, { 1.0, 1.0 - 1e-9 }, xs, ys);
+}
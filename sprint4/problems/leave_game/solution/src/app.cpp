@@ -15,16 +15,19 @@ namespace app {
     Token PlayerToken::GetToken() const { return Token{ strm_.str() }; }
 
     Player::Player() : token_(std::make_unique<PlayerToken>()->GetToken()) {}
-    Player::Player(model::Dog dog, std::shared_ptr<model::GameSession> session, Token token) : dog_(dog), session_(session), token_(token) {}
-    const model::Dog& Player::GetDog() const { return dog_; }
-    void Player::SetDir(std::string dir) { dog_.SetDir(dir); (session_->FindDog(dog_.GetName(), dog_.GetId())).SetDir(dir); }
+    Player::Player(std::shared_ptr<model::GameSession> session, std::uint64_t dog_id, Token token) : session_(session), dog_id_(dog_id), token_(token) {}
+    model::Dog Player::GetDog() const { return session_->GetDog(dog_id_); }
+    std::uint64_t Player::GetDogId() const { return dog_id_; }
+    void Player::SetDir(std::string dir)
+    {
+        session_->SetDogDir(dog_id_, model::DirectionFromString(dir));
+    }
     void Player::SetSpeed(int vX, int vY, double dds)
     {
-        auto map = session_->GetMap();
+        const auto& map = session_->GetMap();
         double vxx = vX * (map.GetSpecificMapDogSpeed() ? map.GetSpecificMapDogSpeed() : dds);
         double vyy = vY * (map.GetSpecificMapDogSpeed() ? map.GetSpecificMapDogSpeed() : dds);
-        dog_.SetSpeed(vxx, vyy);
-        (session_->FindDog(dog_.GetName(), dog_.GetId())).SetSpeed(vxx, vyy);
+        session_->SetDogSpeed(dog_id_, model::Speed{ vxx, vyy });
     }
     void Player::SetSpeed(std::string dir, double game_default_speed) {
         if (dir == "U")
@@ -48,37 +51,39 @@ namespace app {
             SetSpeed(0, 0, game_default_speed);
         }
     }
-    void Player::SyncronizeSession() {
-        dog_ = (session_->FindDog(dog_.GetName(), dog_.GetId()));
-    }
     const model::GameSession& Player::GetSession() const { return *session_; }
     Token Player::GetAuthToken() const { return token_; }
 
-    Player& Players::Addplayer(model::Dog dog, std::shared_ptr<model::GameSession> session)
+    Player& Players::Addplayer(std::uint64_t dog_id, std::shared_ptr<model::GameSession> session)
     {
         auto token = std::make_unique<PlayerToken>()->GetToken();
-        players_by_token_.try_emplace(token, dog, session, token);
-        return players_by_token_[token];
+        token_by_dog_.try_emplace(dog_id, token);
+        return players_by_token_.try_emplace(token, session, dog_id, token).first->second;
     }
     void Players::Addplayer(Token token, Player player) {
+        token_by_dog_.try_emplace(player.GetDogId(), token);
         players_by_token_.try_emplace(token, player);
     }
+    void Players::EraseRetiredPlayers(const std::vector<model::Dog>& retired) {
+        for (const auto& dog : retired)
+        {
+            if (auto search = token_by_dog_.find(dog.GetId()); search != token_by_dog_.end())
+            {
+                players_by_token_.erase(search->second);
+                token_by_dog_.erase(search);
+            }
+        }
+    }
 
-    Player& Players::FindByToken(Token token)
+    Player& Players::FindByToken(const Token& token)
     {
         if (auto search = players_by_token_.find(token); search != players_by_token_.end())
         {
-            return players_by_token_[search->first];
+            return search->second;
         }
         else
         {
             throw std::logic_error("No such player");
         }
     }
-    void Players::SyncronizeSession() {
-        for (auto it = players_by_token_.begin(); it != players_by_token_.end(); it++)
-        {
-            (it->second).SyncronizeSession();
-        }
-    }
 }
\ No newline at end of file
@@ -32,17 +32,18 @@ namespace app {
     class Player {
     public:
         Player();
-        Player(model::Dog dog, std::shared_ptr<model::GameSession> session, Token token);
-        const model::Dog& GetDog() const;
+        // The dog lives in the session, the player only keeps its id
+        Player(std::shared_ptr<model::GameSession> session, std::uint64_t dog_id, Token token);
+        model::Dog GetDog() const;
+        std::uint64_t GetDogId() const;
         void SetDir(std::string dir);
         void SetSpeed(int vX, int vY, double dds);
         void SetSpeed(std::string dir, double game_default_speed);
-        void SyncronizeSession();
         const model::GameSession& GetSession() const;
         Token GetAuthToken() const;
     private:
-        model::Dog dog_;
         std::shared_ptr<model::GameSession> session_;
+        std::uint64_t dog_id_ = 0;
 	    Token token_;
     };
 
@@ -58,33 +59,15 @@ namespace app {
             }
         };
     public:
-        Player& Addplayer(model::Dog dog, std::shared_ptr<model::GameSession> session);
-        Player& FindByToken(Token token);
-        void SyncronizeSession();
+        Player& Addplayer(std::uint64_t dog_id, std::shared_ptr<model::GameSession> session);
+        Player& FindByToken(const Token& token);
         const std::unordered_map<Token, Player, util::TaggedHasher<Token>>& GetPlayersByToken() const { return players_by_token_; }
         void Addplayer(Token token, Player player);
-        std::vector<model::Dog> EraseRetiredPlayers(double time)
-        {
-            std::vector<model::Dog> erased;
-            std::uint64_t integer_time = time * 1000;
-            for (auto it = players_by_token_.begin(); it != players_by_token_.end();)
-            {
-                const auto& player_dog = (it->second).GetDog();
-                erased.push_back(player_dog);
-                if (player_dog.GetTime() >= integer_time)
-                {
-                    const_cast<model::GameSession&>((it->second).GetSession()).RemoveDog(player_dog.GetName(), player_dog.GetId());
-                    it = players_by_token_.erase(it);
-                }  
-                else
-                {
-                    ++it;
-                } 
-            }
-            return erased;
-        }
+        // Drops the players of dogs their sessions have already retired
+        void EraseRetiredPlayers(const std::vector<model::Dog>& retired);
     private:
         std::unordered_map<Token, Player, util::TaggedHasher<Token>> players_by_token_;
+        std::unordered_map<std::uint64_t, Token> token_by_dog_;
     };
 
     class ApplicationListener {
@@ -6,21 +6,10 @@
 #include <filesystem>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/unordered_map.hpp>
+#include <boost/serialization/version.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 
-namespace cpy {
-
-    template<class InputIt, class OutputIt>
-    OutputIt copy(InputIt first, InputIt last, OutputIt d_first)
-    {
-        for (; first != last; (void)++first, (void)++d_first)
-            *d_first = typename OutputIt::value_type(*first); //improve STL copy in order to maintain emplace_back() functionality in my program
-
-        return d_first;
-    }
-}
-
 namespace model {
     template <typename Archive>
     void serialize(Archive& ar, model::Position& pos, [[maybe_unused]] const unsigned version) {
@@ -42,6 +31,13 @@ namespace model {
         ar& lobj.type_;
         ar& lobj.score_per_obj_;
     }
+
+    template <typename Archive>
+    void serialize(Archive& ar, model::BagItem& item, [[maybe_unused]] const unsigned version) {
+        ar& item.id;
+        ar& item.type;
+        ar& item.value;
+    }
 }
 
 namespace app {
@@ -62,8 +58,8 @@ namespace serialization {
             , id_(dog.GetId())
             , pos_(dog.GetPos())
             , spd_(dog.GetSpd())
-            , dir_(dog.GetDir())
-            , bag_(dog.GetBag())
+            , dir_(model::DirectionToString(dog.GetDir()))
+            , bag_(dog.GetBag().begin(), dog.GetBag().end())
             , score_(dog.GetScore()) 
             , map_(dog.GetRoad().GetMap())
             , road_id_(*dog.GetRoad().GetId())
@@ -77,7 +73,7 @@ namespace serialization {
             const model::Road* road = map->FindRoad(model::Road::Id{ road_id_ });
             dog.SetRoad(road);
             dog.SetSpeed(spd_.vx, spd_.vy);
-            dog.SetDir(dir_);
+            dog.SetDir(model::DirectionFromString(dir_));
             for (const auto& item : bag_) {
                 dog.AddLoot(item);
             }
@@ -86,14 +82,30 @@ namespace serialization {
             return dog;
         }
 
+        std::uint64_t GetId() const { return id_; }
+
+        // version 0 stored whole lost objects in bags, they are still readable
         template <typename Archive>
-        void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        void serialize(Archive& ar, const unsigned version) {
             ar& name_;
             ar& id_;
             ar& pos_;
             ar& spd_;
             ar& dir_;
-            ar& bag_;
+            if (version == 0)
+            {
+                std::vector<model::LostObject> bag;
+                ar& bag;
+                bag_.clear();
+                for (const auto& obj : bag)
+                {
+                    bag_.push_back(model::BagItem{ obj.GetId(), obj.GetType(), obj.GetScorePerObj() });
+                }
+            }
+            else
+            {
+                ar& bag_;
+            }
             ar& score_;
             ar& map_;
             ar& road_id_;
@@ -106,7 +118,7 @@ namespace serialization {
         model::Position pos_;
         model::Speed spd_;
         std::string dir_ = "U";
-        std::vector<model::LostObject> bag_;
+        std::vector<model::BagItem> bag_;
         std::uint64_t score_ = 0;
         std::string map_;
         std::uint64_t road_id_ = 0;
@@ -123,8 +135,11 @@ namespace serialization {
             loot_count_(session.GetLootCount()), map_(*session.GetMap().GetId())
         {
             const auto& dogs = session.GetDogs();
-            dogs_.resize(dogs.size());
-            cpy::copy(dogs.begin(), dogs.end(), dogs_.begin());
+            dogs_.reserve(dogs.Size());
+            for (size_t slot = 0; slot < dogs.Size(); slot++)
+            {
+                dogs_.emplace_back(dogs.Get(slot, session.GetMap()));
+            }
         }
 
         [[nodiscard]] model::GameSession Restore(const model::Game& game) const {
@@ -171,7 +186,8 @@ namespace serialization {
 
         [[nodiscard]] app::Player Restore(const model::Game& game, const model::SessionManager& sm) const {
             const model::Map* map = game.FindMap(model::Map::Id{ map_ });
-            return app::Player{ dog_.Restore(game), sm.FindSession(map, session_id_), app::Token{token_} };
+            // the dog itself is restored with its session, the player only needs its id
+            return app::Player{ sm.FindSession(map, session_id_), dog_.GetId(), app::Token{token_} };
         }
 
         template <typename Archive>
@@ -220,6 +236,8 @@ namespace serialization {
     };
 }
 
+BOOST_CLASS_VERSION(::serialization::DogRepr, 1)
+
 class SerializingListener : public app::ApplicationListener {
     using InputArchive = boost::archive::text_iarchive;
     using OutputArchive = boost::archive::text_oarchive;
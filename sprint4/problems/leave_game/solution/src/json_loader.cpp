@@ -1,5 +1,4 @@
 #include "json_loader.h"
-#include "loottypes.h"
 
 namespace json = boost::json;
 using namespace std::literals;
@@ -31,56 +30,72 @@ void LoadMaps(const json::array& maps, model::Game& game)
         {
             map.AddSpecificBagCapacity(game.GetDefaultBagCapacity());
         }
+        ::boost::json::value const* const p_value3{ m.as_object().if_contains(MAP_SESSION_CAPACITY) };
+        if (p_value3)
+        {
+            map.AddSessionCapacity(m.as_object().at(MAP_SESSION_CAPACITY).as_int64());
+        }
+        else
+        {
+            map.AddSessionCapacity(game.GetDefaultSessionCapacity());
+        }
+        ::boost::json::value const* const p_value4{ m.as_object().if_contains(MAP_VIEW_RADIUS) };
+        if (p_value4)
+        {
+            map.AddViewRadius(m.as_object().at(MAP_VIEW_RADIUS).as_double());
+        }
         LoadRoads(m.as_object().at(ROADS).as_array(), map);
         LoadBuildings(m.as_object().at(BUILDINGS).as_array(), map);
         LoadOffices(m.as_object().at(OFFICES).as_array(), map);
+        LoadLootTypes(m.as_object().at(LOOT_TYPES).as_array(), map);
         game.AddMap(map);
-        
-        auto loot_info = m.as_object().at(LOOT_TYPES).as_array();
-        json::array arr;
-        
-        for (const auto& item : loot_info)
-        {
-            boost::json::object obj;
-            ::boost::json::value const* const p_value_name{ item.as_object().if_contains(NAME) };
-            if (p_value_name)
-            {
-                obj.emplace(NAME, static_cast<std::string>(item.as_object().at(NAME).as_string()));
-            }
-            ::boost::json::value const* const p_value_file{ item.as_object().if_contains(FILE) };
-            if (p_value_file)
-            {
-                obj.emplace(FILE, static_cast<std::string>(item.as_object().at(FILE).as_string()));
-            }
-            ::boost::json::value const* const p_value_type{ item.as_object().if_contains(TYPE) };
-            if (p_value_type)
-            {
-                obj.emplace(TYPE, static_cast<std::string>(item.as_object().at(TYPE).as_string()));
-            }
-            ::boost::json::value const* const p_value_rot{ item.as_object().if_contains(ROTATION) };
-            if (p_value_rot)
-            {
-                obj.emplace(ROTATION, item.as_object().at(ROTATION).as_int64());
-            }
-            ::boost::json::value const* const p_value_col{ item.as_object().if_contains(COLOR) };
-            if (p_value_col)
-            {
-                obj.emplace(COLOR, static_cast<std::string>(item.as_object().at(COLOR).as_string()));
-            }
-            ::boost::json::value const* const p_value_scale{ item.as_object().if_contains(SCALE) };
-            if (p_value_scale)
-            {
-                obj.emplace(SCALE, item.as_object().at(SCALE).as_double());
-            }
-            ::boost::json::value const* const p_value_value{ item.as_object().if_contains(VALUE) };
-            if (p_value_scale)
-            {
-                obj.emplace(VALUE, item.as_object().at(VALUE).as_int64());
-            }
-            arr.emplace_back(obj);
-        }
-
-        loot_types::to_frontend_loot_type_data[static_cast<std::string>(m.as_object().at(ID).as_string())] = arr;
+    }
+}
+void LoadLootTypes(const json::array& loot_types, model::Map& map)
+{
+    for (const auto& item : loot_types)
+    {
+        model::LootType loot_type;
+        boost::json::object obj;
+        ::boost::json::value const* const p_value_name{ item.as_object().if_contains(NAME) };
+        if (p_value_name)
+        {
+            loot_type.name = static_cast<std::string>(item.as_object().at(NAME).as_string());
+            obj.emplace(NAME, loot_type.name);
+        }
+        ::boost::json::value const* const p_value_file{ item.as_object().if_contains(FILE) };
+        if (p_value_file)
+        {
+            obj.emplace(FILE, static_cast<std::string>(item.as_object().at(FILE).as_string()));
+        }
+        ::boost::json::value const* const p_value_type{ item.as_object().if_contains(TYPE) };
+        if (p_value_type)
+        {
+            obj.emplace(TYPE, static_cast<std::string>(item.as_object().at(TYPE).as_string()));
+        }
+        ::boost::json::value const* const p_value_rot{ item.as_object().if_contains(ROTATION) };
+        if (p_value_rot)
+        {
+            obj.emplace(ROTATION, item.as_object().at(ROTATION).as_int64());
+        }
+        ::boost::json::value const* const p_value_col{ item.as_object().if_contains(COLOR) };
+        if (p_value_col)
+        {
+            obj.emplace(COLOR, static_cast<std::string>(item.as_object().at(COLOR).as_string()));
+        }
+        ::boost::json::value const* const p_value_scale{ item.as_object().if_contains(SCALE) };
+        if (p_value_scale)
+        {
+            obj.emplace(SCALE, item.as_object().at(SCALE).as_double());
+        }
+        ::boost::json::value const* const p_value_value{ item.as_object().if_contains(VALUE) };
+        if (p_value_value)
+        {
+            loot_type.value = static_cast<int>(item.as_object().at(VALUE).as_int64());
+            obj.emplace(VALUE, loot_type.value);
+        }
+        loot_type.frontend_json = json::serialize(obj);
+        map.AddLootType(std::move(loot_type));
     }
 }
 void LoadRoads(const json::array& roads, model::Map& map)
@@ -167,6 +182,12 @@ model::Game LoadGame(const std::filesystem::path& json_path) {
             game.AddRetTime(value.as_object().at(DEFAULT_RETIREMENT_TIME).as_double());
         }
 
+        ::boost::json::value const* const p_value4{ value.as_object().if_contains(DEFAULT_SESSION_CAPACITY) };
+        if (p_value4)
+        {
+            game.AddDefaultSessionCapacity(value.as_object().at(DEFAULT_SESSION_CAPACITY).as_int64());
+        }
+
         LoadMaps(maps, game);
         in.close();
         return game;
@@ -47,11 +47,15 @@ const std::string VALUE = "value";
 const std::string DEFAULT_BAG_CAPACITY = "defaultBagCapacity";
 const std::string MAP_BAG_CAPACITY = "bagCapacity";
 const std::string DEFAULT_RETIREMENT_TIME = "dogRetirementTime";
+const std::string DEFAULT_SESSION_CAPACITY = "defaultSessionCapacity";
+const std::string MAP_SESSION_CAPACITY = "sessionCapacity";
+const std::string MAP_VIEW_RADIUS = "viewRadius";
 
 void LoadMaps(const boost::json::array& maps, model::Game& game);
 void LoadRoads(const boost::json::array& roads, model::Map& map);
 void LoadBuildings(const boost::json::array& buildings, model::Map& map);
 void LoadOffices(const boost::json::array& maps, model::Map& map);
+void LoadLootTypes(const boost::json::array& loot_types, model::Map& map);
 
 model::Game LoadGame(const std::filesystem::path& json_path);
 
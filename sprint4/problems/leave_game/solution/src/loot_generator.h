@@ -1,15 +1,39 @@
 #pragma once
+#include <algorithm>
 #include <chrono>
-#include <functional>
+#include <cmath>
+#include <cstdint>
+#include "rng.h"
 
 namespace loot_gen {
 
+/*
+ *  Источник случайности по умолчанию: равномерное распределение на [0, 1)
+ *  поверх собственного Xoshiro256, каждая игровая сессия засевает его своим seed
+ */
+class UniformRandom {
+public:
+    explicit UniformRandom(std::uint64_t seed = 0) noexcept
+        : random_{seed} {
+    }
+
+    double operator()() noexcept {
+        // старшие 53 бита дают все значения double из [0, 1) с равным шагом
+        return static_cast<double>(random_() >> 11) * 0x1.0p-53;
+    }
+
+private:
+    rng::Xoshiro256 random_;
+};
+
 /*
  *  Генератор трофеев
+ *  RandomGenerator - функтор без аргументов, возвращающий число в диапазоне от [0 до 1].
+ *  Хранится по значению, без std::function, поэтому копирование и вызов дешёвые.
  */
-class LootGenerator {
+template <typename RandomGenerator = UniformRandom>
+class BasicLootGenerator {
 public:
-    using RandomGenerator = std::function<double()>;
     using TimeInterval = std::chrono::milliseconds;
 
     /*
@@ -17,13 +41,18 @@ public:
      * probability - вероятность появления трофея в течение базового интервала времени
      * random_generator - генератор псевдослучайных чисел в диапазоне от [0 до 1]
      */
-    LootGenerator(TimeInterval base_interval, double probability,
-                  RandomGenerator random_gen = DefaultGenerator)
+    BasicLootGenerator(TimeInterval base_interval, double probability,
+                       RandomGenerator random_gen = RandomGenerator{})
         : base_interval_{base_interval}
         , probability_{probability}
         , random_generator_{std::move(random_gen)} {
     }
 
+    // Заменяет источник случайности, накопленное время без трофеев сохраняется
+    void SetRandomGenerator(RandomGenerator random_gen) {
+        random_generator_ = std::move(random_gen);
+    }
+
     /*
      * Возвращает количество трофеев, которые должны появиться на карте спустя
      * заданный промежуток времени.
@@ -33,16 +62,28 @@ public:
      * loot_count - количество трофеев на карте до вызова Generate
      * looter_count - количество мародёров на карте
      */
-    unsigned Generate(TimeInterval time_delta, unsigned loot_count, unsigned looter_count);
+    unsigned Generate(TimeInterval time_delta, unsigned loot_count, unsigned looter_count) {
+        time_without_loot_ += time_delta;
+        const unsigned loot_shortage = loot_count > looter_count ? 0u : looter_count - loot_count;
+        const double ratio = std::chrono::duration<double>{time_without_loot_} / base_interval_;
+        const double probability
+            = std::clamp((1.0 - std::pow(1.0 - probability_, ratio)) * random_generator_(), 0.0, 1.0);
+        const unsigned generated_loot = static_cast<unsigned>(std::round(loot_shortage * probability));
+        if (generated_loot > 0) {
+            time_without_loot_ = {};
+        }
+        return generated_loot;
+    }
 
 private:
-    static double DefaultGenerator() noexcept {
-        return 1.0;
-    };
     TimeInterval base_interval_;
     double probability_;
     TimeInterval time_without_loot_{};
     RandomGenerator random_generator_;
 };
 
+using LootGenerator = BasicLootGenerator<>;
+
+extern template class BasicLootGenerator<UniformRandom>;
+
 }  // namespace loot_gen
@@ -82,6 +82,8 @@ struct Args {
     std::string save_path;
     std::uint64_t save_period = 0;
     bool randomize_spawn_points = false;
+    unsigned tick_threads = 0;
+    std::optional<std::uint64_t> seed;
 };
 
 
@@ -99,7 +101,9 @@ struct Args {
         ("www-root,w", po::value(&args.static_path)->value_name("dir"s), "set static files root")
         ("randomize-spawn-points", "spawn dogs at random positions")
         ("state-file,s", po::value(&args.save_path)->value_name("file"s), "set save file path")
-        ("save-state-period,ts", po::value(&args.save_period)->value_name("milliseconds"s), "set save period");
+        ("save-state-period,ts", po::value(&args.save_period)->value_name("milliseconds"s), "set save period")
+        ("tick-threads", po::value(&args.tick_threads)->value_name("count"s), "set number of threads updating game sessions")
+        ("seed", po::value<std::uint64_t>()->value_name("number"s), "set random seed for reproducible runs");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -122,6 +126,9 @@ struct Args {
     if (vm.contains("randomize-spawn-points"s)) {
         args.randomize_spawn_points = true;
     }
+    if (vm.contains("seed"s)) {
+        args.seed = vm["seed"s].as<std::uint64_t>();
+    }
     // С опциями программы всё в порядке, возвращаем структуру args
     return args;
 }
@@ -160,7 +167,7 @@ int main(int argc, const char* argv[]) {
             model::Game game = json_loader::LoadGame((*args).config_path);
             loot_gen::LootGenerator lg = json_loader::LoadLootGenerator((*args).config_path);
             app::Players players;
-            model::SessionManager sm;
+            model::SessionManager sm{ lg, (*args).seed ? *(*args).seed : std::random_device{}(), static_cast<std::uint64_t>(game.GetRetTime() * 1000) };
             // 2. Инициализируем io_context
             const unsigned num_threads = std::thread::hardware_concurrency();
             net::io_context ioc(num_threads);
@@ -185,6 +192,8 @@ int main(int argc, const char* argv[]) {
             {
                 sm.Initialize(game.GetMaps());
             }
+            // По умолчанию сессии обновляются на всех ядрах
+            sm.SetTickThreads((*args).tick_threads ? (*args).tick_threads : num_threads);
 
             // 3. Добавляем асинхронный обработчик сигналов SIGINT и SIGTERM
             // Подписываемся на сигналы и при их получении завершаем работу сервера
@@ -221,7 +230,7 @@ int main(int argc, const char* argv[]) {
 
             auto api_handler = http_handler::ApiHandler{ game, players, sm,
                 (*args).tick_period, (*args).randomize_spawn_points,
-                lg, serializing_listener, conn_pool};
+                serializing_listener, conn_pool};
 
             // 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры
             auto handler = std::make_shared<http_handler::RequestHandler>(game, (*args).static_path, api_strand, api_handler);
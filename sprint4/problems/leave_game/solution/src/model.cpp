@@ -1,59 +1,150 @@
 #include "model.h"
-#include "loottypes.h"
 #include <stdexcept>
 #include <algorithm>
+#include <map>
+#include <tuple>
+#include <atomic>
+#include <latch>
+#include <mutex>
+#include <exception>
+#include <boost/asio/post.hpp>
 
 namespace model {
-std::uint64_t dogs_ids = 0;
-std::uint64_t lost_obj_ids = 0;
+// sessions are ticked in parallel, so ids are handed out atomically
+std::atomic<std::uint64_t> dogs_ids = 0;
+std::atomic<std::uint64_t> lost_obj_ids = 0;
 const double road_offset = 0.4;
 
 const double item_width = 0.0;
 const double gatherer_width = 0.3;
 const double base_width = 0.25;
+const double collision_lane_width = 1.0;
 
 using namespace std::literals;
 
-std::optional<Point> IsIntersect(const Road& r1, const Road& r2) {
-    if (r1.IsHorizontal() && r2.IsVertical())
-    {
-        auto r1_st = r1.GetStart();
-        auto r1_fn = r1.GetEnd();
-        auto r2_st = r2.GetStart();
-        auto r2_fn = r2.GetEnd();
-        auto lesser_r1_x = r1_st.x < r1_fn.x ? r1_st.x : r1_fn.x;
-        auto greater_r1_x = r1_st.x > r1_fn.x ? r1_st.x : r1_fn.x;
-        auto lesser_r2_y = r2_st.y < r2_fn.y ? r2_st.y : r2_fn.y;
-        auto greater_r2_y = r2_st.y > r2_fn.y ? r2_st.y : r2_fn.y;
-        if (lesser_r1_x <= r2_st.x && r2_st.x <= greater_r1_x && lesser_r2_y <= r1_st.y && r1_st.y <= greater_r2_y)
-        {
-            return Point{ r2_st.x, r1_st.y };
-        }
+Direction DirectionFromString(std::string_view dir) {
+    if (dir == "U"sv)
+    {
+        return Direction::UP;
     }
-    if (r1.IsVertical() && r2.IsHorizontal())
-    {
-        auto r1_st = r2.GetStart();
-        auto r1_fn = r2.GetEnd();
-        auto r2_st = r1.GetStart();
-        auto r2_fn = r1.GetEnd();
-        auto lesser_r1_x = r1_st.x < r1_fn.x ? r1_st.x : r1_fn.x;
-        auto greater_r1_x = r1_st.x > r1_fn.x ? r1_st.x : r1_fn.x;
-        auto lesser_r2_y = r2_st.y < r2_fn.y ? r2_st.y : r2_fn.y;
-        auto greater_r2_y = r2_st.y > r2_fn.y ? r2_st.y : r2_fn.y;
-        if (lesser_r1_x <= r2_st.x && r2_st.x <= greater_r1_x && lesser_r2_y <= r1_st.y && r1_st.y <= greater_r2_y)
-        {
-            return Point{ r2_st.x, r1_st.y };
-        }
+    if (dir == "D"sv)
+    {
+        return Direction::DOWN;
     }
-    return std::nullopt;
+    if (dir == "L"sv)
+    {
+        return Direction::LEFT;
+    }
+    if (dir == "R"sv)
+    {
+        return Direction::RIGHT;
+    }
+    return Direction::NONE;
+}
+
+std::string_view DirectionToString(Direction dir) {
+    switch (dir)
+    {
+    case Direction::UP:
+        return "U"sv;
+    case Direction::DOWN:
+        return "D"sv;
+    case Direction::LEFT:
+        return "L"sv;
+    case Direction::RIGHT:
+        return "R"sv;
+    default:
+        return ""sv;
+    }
+}
+
+namespace {
+
+constexpr Axis OtherAxis(Axis axis) {
+    return axis == Axis::X ? Axis::Y : Axis::X;
 }
 
-int GetRandomNumber(int max_number) {
-    std::random_device rd;
+template <Axis axis>
+bool IsAlong(Direction dir) {
+    if constexpr (axis == Axis::X)
+    {
+        return dir == Direction::LEFT || dir == Direction::RIGHT;
+    }
+    else
+    {
+        return dir == Direction::UP || dir == Direction::DOWN;
+    }
+}
+
+bool IsBackward(Direction dir) {
+    return dir == Direction::LEFT || dir == Direction::UP;
+}
+
+template <Axis axis>
+double& AxisOf(Position& pos) {
+    if constexpr (axis == Axis::X)
+    {
+        return pos.x;
+    }
+    else
+    {
+        return pos.y;
+    }
+}
+
+template <Axis axis>
+double AxisOf(Speed spd) {
+    if constexpr (axis == Axis::X)
+    {
+        return spd.vx;
+    }
+    else
+    {
+        return spd.vy;
+    }
+}
+
+template <Axis axis>
+Coord AxisOf(Point p) {
+    if constexpr (axis == Axis::X)
+    {
+        return p.x;
+    }
+    else
+    {
+        return p.y;
+    }
+}
+
+template <Axis axis>
+double LowerBound(const Road& road) {
+    return std::min(AxisOf<axis>(road.GetStart()), AxisOf<axis>(road.GetEnd())) - road_offset;
+}
+
+template <Axis axis>
+double UpperBound(const Road& road) {
+    return std::max(AxisOf<axis>(road.GetStart()), AxisOf<axis>(road.GetEnd())) + road_offset;
+}
+
+// Moves coord by delta towards the lower (backward) or upper bound.
+// Returns false if the bound has been reached and the dog has to stop.
+bool Advance(double& coord, double delta, bool backward, double lower, double upper) {
+    if (backward ? coord + delta <= lower : coord + delta >= upper)
+    {
+        coord = backward ? lower : upper;
+        return false;
+    }
+    coord += delta;
+    return true;
+}
+
+int GetRandomNumber(int max_number, rng::Xoshiro256& random) {
     std::uniform_int_distribution<int> dist_int(0, max_number);
-    return dist_int(rd);
+    return dist_int(random);
 }
 
+}  // namespace
+
 void Map::AddOffice(Office office) {
     if (warehouse_id_to_index_.contains(office.GetId())) {
         throw std::invalid_argument("Duplicate warehouse");
@@ -70,17 +161,16 @@ void Map::AddOffice(Office office) {
     }
 }
 
-std::pair<const Road*, Position> Map::GetRandomPosition(bool randomize_spawn_points) const {
+std::pair<const Road*, Position> Map::GetRandomPosition(bool randomize_spawn_points, rng::Xoshiro256& random) const {
     const auto& roads = GetRoads();
     if (randomize_spawn_points)
     {
-        std::random_device rd;
         std::uniform_int_distribution<int> dist_int(0, roads.size() - 1);
-        const auto& road = roads[dist_int(rd)];
+        const auto& road = roads[dist_int(random)];
         auto road_start = road.GetStart(); auto road_end = road.GetEnd();
         int start, end; start = road.IsHorizontal() ? road_start.x : road_start.y; end = road.IsHorizontal() ? road_end.x : road_end.y;
         std::uniform_real_distribution<> dist_double(start, end);
-        auto value = std::round(dist_double(rd) * 10) / 10;
+        auto value = std::round(dist_double(random) * 10) / 10;
         return std::make_pair(&road, road.IsHorizontal() ? Position{ value, static_cast<double>(road_start.y) } : Position{ static_cast<double>(road_start.x), value });
     }
     else
@@ -92,22 +182,75 @@ std::pair<const Road*, Position> Map::GetRandomPosition(bool randomize_spawn_poi
 }
 
 void Map::CreateRoadGrid() {
-    for (int i = 0; i < roads_.size(); i++)
+    // Sweep a vertical line along x: horizontal roads stay active while the line is within their x range,
+    // every vertical road picks the active ones by its y range. O(n log n + k) for n roads and k crossings.
+    enum EventKind { OPEN, QUERY, CLOSE };  // at equal x: open before query before close, road ends are inclusive
+    struct Event {
+        Coord x;
+        EventKind kind;
+        size_t road;
+    };
+
+    std::vector<Event> events;
+    events.reserve(roads_.size() * 2);
+    for (size_t i = 0; i < roads_.size(); i++)
     {
-        for (int j = 0; j < roads_.size(); j++)
+        const auto start = roads_[i].GetStart();
+        const auto end = roads_[i].GetEnd();
+        if (roads_[i].IsHorizontal())
         {
-            if (i != j)
+            events.push_back({ std::min(start.x, end.x), OPEN, i });
+            events.push_back({ std::max(start.x, end.x), CLOSE, i });
+        }
+        else
+        {
+            events.push_back({ start.x, QUERY, i });
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const Event& l, const Event& r) {
+        return std::tie(l.x, l.kind, l.road) < std::tie(r.x, r.kind, r.road);
+    });
+
+    crossings_.clear();
+    road_crossings_.assign(roads_.size(), {});
+    std::multimap<Coord, size_t> active;
+    std::vector<std::multimap<Coord, size_t>::iterator> active_pos(roads_.size());
+    for (const auto& e : events)
+    {
+        switch (e.kind)
+        {
+        case OPEN:
+            active_pos[e.road] = active.emplace(roads_[e.road].GetStart().y, e.road);
+            break;
+        case CLOSE:
+            active.erase(active_pos[e.road]);
+            break;
+        case QUERY:
+        {
+            const auto start = roads_[e.road].GetStart();
+            const auto end = roads_[e.road].GetEnd();
+            const auto upper = std::max(start.y, end.y);
+            for (auto it = active.lower_bound(std::min(start.y, end.y)); it != active.end() && it->first <= upper; ++it)
             {
-                if (auto p = IsIntersect(roads_[i], roads_[j]))
-                {
-                    grid_.try_emplace(*p, roads_[i], roads_[j]);
-                    auto& vi = roads_to_crosses_[roads_[i]];
-                    auto& vj = roads_to_crosses_[roads_[j]];
-                    vi.push_back(*p);
-                    vj.push_back(*p);
-                }
+                road_crossings_[it->second].push_back(crossings_.size());
+                road_crossings_[e.road].push_back(crossings_.size());
+                crossings_.push_back({ Point{ e.x, it->first }, it->second, e.road });
             }
+            break;
         }
+        }
+    }
+
+    for (size_t i = 0; i < roads_.size(); i++)
+    {
+        const bool horizontal = roads_[i].IsHorizontal();
+        std::sort(road_crossings_[i].begin(), road_crossings_[i].end(), [&](size_t l, size_t r) {
+            const auto& cl = crossings_[l];
+            const auto& cr = crossings_[r];
+            const Coord pl = horizontal ? cl.point.x : cl.point.y;
+            const Coord pr = horizontal ? cr.point.x : cr.point.y;
+            return std::make_pair(pl, cl.Other(i)) < std::make_pair(pr, cr.Other(i));
+        });
     }
 }
 
@@ -127,405 +270,609 @@ void Game::AddMap(Map map) {
 
 Dog::Dog(std::string name, Position pos, const Road* r) : name_(name), id_(dogs_ids++), pos_(pos), r_(r) {}
 
-GameSession::GameSession(const Map* map, std::uint64_t id) : map_(map), id_(id) {}
-void GameSession::AddDog(Dog d) { dogs_.push_back(d); }
+// with cells as wide as the view radius a visibility query touches at most 3x3 cells
+GameSession::GameSession(const Map* map, std::uint64_t id)
+    : map_(map), id_(id), dogs_(map->GetSpecificBagCapacity()), collision_world_(map->GetOffices()), dog_grid_(std::max(map->GetViewRadius(), 1.0)), lost_object_grid_(std::max(map->GetViewRadius(), 1.0)) {}
+std::pair<const Road*, Position> GameSession::GetSpawnPosition(bool randomize_spawn_points) {
+    return map_->GetRandomPosition(randomize_spawn_points, random_);
+}
+void GameSession::AddDog(Dog d) {
+    const auto slot = dogs_.Add(d, map_->GetRoadIndex(d.GetRoad()));
+    ScheduleRetirement(slot);
+    pending_.dogs.push_back(d.GetId());
+    cached_state_.reset();
+    if (HasViewRadius())
+    {
+        dog_grid_.Insert(d.GetId(), dogs_.Positions()[slot]);
+    }
+}
 int GameSession::GetLootCount() const { return loot_count_; }
 const std::unordered_map<std::uint64_t, LostObject>& GameSession::GetLostObjects() const { return lost_objects_; }
-void GameSession::AddLostObject(std::uint64_t id, LostObject obj) { lost_objects_[id] = obj; }
-Dog& GameSession::FindDog(std::string name, std::uint64_t id) {
-    Dog temp(name, id);
-    if (auto search = std::find(dogs_.begin(), dogs_.end(), temp); search != dogs_.end())
+void GameSession::AddLostObject(std::uint64_t id, LostObject obj) {
+    lost_objects_[id] = obj;
+    collision_world_.AddLostObject(id, Position{ obj.GetX(), obj.GetY() });
+    pending_.lost_objects.push_back(id);
+    cached_state_.reset();
+    if (HasViewRadius())
     {
-        return dogs_[static_cast<int>(std::distance(dogs_.begin(), search))];
+        lost_object_grid_.Insert(id, Position{ obj.GetX(), obj.GetY() });
     }
-    else
+}
+size_t GameSession::GetDogSlot(std::uint64_t id) const {
+    if (auto slot = dogs_.FindSlot(id))
+    {
+        return *slot;
+    }
+    throw std::logic_error("No such dog");
+}
+Dog GameSession::GetDog(std::uint64_t id) const { return dogs_.Get(GetDogSlot(id), *map_); }
+std::uint64_t GameSession::GetDogIdleTime(std::uint64_t id) const { return dogs_.IdleTime(GetDogSlot(id)); }
+void GameSession::SetDogDir(std::uint64_t id, Direction dir) {
+    const auto slot = GetDogSlot(id);
+    dogs_.SetDirection(slot, dir);
+    ScheduleRetirement(slot);
+    pending_.dogs.push_back(id);
+    cached_state_.reset();
+}
+void GameSession::SetDogSpeed(std::uint64_t id, Speed spd) {
+    dogs_.SetSpeed(GetDogSlot(id), spd);
+    pending_.dogs.push_back(id);
+    cached_state_.reset();
+}
+void GameSession::RemoveDog(std::uint64_t id) {
+    const auto slot = GetDogSlot(id);
+    if (HasViewRadius())
     {
-        throw std::logic_error("No such dog");
+        dog_grid_.Erase(id, dogs_.Positions()[slot]);
     }
+    dogs_.Remove(slot);
+    retirement_.Cancel(id);
+    pending_.removed_dogs.push_back(id);
+    cached_state_.reset();
 }
-void GameSession::RemoveDog(std::string name, std::uint64_t id) {
-    Dog temp(name, id);
-    for (auto it = dogs_.begin(); it != dogs_.end(); it++)
+void GameSession::SetRetirementTime(std::uint64_t time) {
+    retirement_time_ = time;
+    for (size_t slot = 0; slot < dogs_.Size(); ++slot)
     {
-        if ((*it) == temp)
-        {
-            dogs_.erase(it);
-            return;
-        }
+        ScheduleRetirement(slot);
+    }
+}
+void GameSession::ScheduleRetirement(size_t slot) {
+    if (!retirement_time_)
+    {
+        return;
+    }
+    const auto id = dogs_.Info(slot).id;
+    const auto idle = dogs_.IdleTime(slot);
+    // idle time grows only while the dog stands, a moving dog retires only if it is already overdue
+    if (dogs_.Directions()[slot] == Direction::NONE || idle >= *retirement_time_)
+    {
+        retirement_.Schedule(id, dogs_.Now() + *retirement_time_ - std::min(idle, *retirement_time_));
+    }
+    else
+    {
+        retirement_.Cancel(id);
     }
-    throw std::logic_error("No such dog");
 }
-void GameSession::UpdateSession(std::uint64_t time, loot_gen::LootGenerator lg) {
+void GameSession::UpdateSession(std::uint64_t time, boost::asio::thread_pool* collision_pool, unsigned collision_threads) {
     //movement implementation
 
-    auto different_items_to_generate_amount = loot_types::to_frontend_loot_type_data[*GetMap().GetId()].size();
-    auto items_to_generate = const_cast<loot_gen::LootGenerator&>(lg).Generate(std::chrono::milliseconds(time), GetLootCount(), GetPlayersAmount());
+    const auto& loot_types = GetMap().GetLootTypes();
+    auto items_to_generate = loot_types.empty() ? 0u : loot_generator_.Generate(std::chrono::milliseconds(time), GetLootCount(), GetPlayersAmount());
 
     for (int i = 0; i < items_to_generate; i++)
     {
-        auto random_pos = GetMap().GetRandomPosition(true).second;
+        auto random_pos = GetMap().GetRandomPosition(true, random_).second;
         auto lost_obj_id = lost_obj_ids++;
-        auto lost_obj_type = GetRandomNumber(different_items_to_generate_amount - 1);
-        AddLostObject(lost_obj_id, LostObject{random_pos.x, random_pos.y, lost_obj_id, lost_obj_type, static_cast<int>(loot_types::to_frontend_loot_type_data[*GetMap().GetId()][lost_obj_type].as_object().at(VALUE).as_int64())});
+        auto lost_obj_type = GetRandomNumber(loot_types.size() - 1, random_);
+        AddLostObject(lost_obj_id, LostObject{random_pos.x, random_pos.y, lost_obj_id, lost_obj_type, loot_types[lost_obj_type].value});
     }
     loot_count_ += items_to_generate;
 
-    std::vector<std::pair<Position, Position>> gatherers_moves_per_tick(GetPlayersAmount());
-
-    const auto& m = GetMap();    
-    for (auto& d : dogs_)
+    // Only moving dogs are visited: stopped ones neither move nor gather, and their idle time
+    // is derived from the session clock. gatherer_slots maps gatherer indices back to slots.
+    const auto& active = dogs_.Active();
+    std::vector<std::uint32_t> gatherer_slots;
+    gatherer_slots.reserve(active.size());
+    collision_world_.ClearGatherers();
+
+    const auto& m = GetMap();
+    const auto& roads = m.GetRoads();
+    const auto& positions = dogs_.Positions();
+    const auto& dog_roads = dogs_.Roads();
+    const double time_sec = time * 1.0 / 1000;
+    const bool track_visibility = HasViewRadius();
+    for (const auto slot : active)
     {
-        auto pos = d.GetPos();
-        auto old_pos = pos;
-        auto spd = d.GetSpd();
-        auto dir = d.GetDir();
-        double time_sec = time * 1.0 / 1000;
-        const auto& current_road = d.GetRoad();
+        const auto old_pos = positions[slot];
 
-        if (current_road.IsHorizontal())
+        if (roads[dog_roads[slot]].IsHorizontal())
         {
-            ProcessHorizontalRoad(d, current_road, pos, spd, dir, time_sec, m);
+            MoveDog<Axis::X>(slot, time_sec, m);
         }
         else
         {
-            ProcessVerticalRoad(d, current_road, pos, spd, dir, time_sec, m);
+            MoveDog<Axis::Y>(slot, time_sec, m);
         }
 
-        d.Move(pos);
-        if(dir == "")
-            d.AddTime(time);
-        gatherers_moves_per_tick[d.GetId()] = std::make_pair(old_pos, pos);
+        collision_world_.AddGatherer(old_pos, positions[slot]);
+        gatherer_slots.push_back(slot);
+        pending_.dogs.push_back(dogs_.Info(slot).id);
+        if (track_visibility)
+        {
+            dog_grid_.Move(dogs_.Info(slot).id, old_pos, positions[slot]);
+        }
     }
+    dogs_.AdvanceClock(time);
+    dogs_.DeactivateStopped();
 
-    auto offices_in_items = prov.Initialize(GetLostObjects(), gatherers_moves_per_tick, m.GetOffices());
-    auto events = collision_detector::FindGatherEvents(prov);
-
-    for (const auto& event : events)
+    // picked objects leave the world after all events are handled, removal moves item indices
+    std::vector<std::uint64_t> picked;
+    for (const auto& event : collision_world_.FindGatherEvents(collision_pool, collision_threads))
     {
-        if (lost_objects_.find(event.item_id) != lost_objects_.end() && dogs_[event.gatherer_id].CanLoot(m.GetSpecificBagCapacity()))
+        const auto slot = gatherer_slots[event.gatherer_id];
+        const auto lost_object_id = collision_world_.GetLostObjectId(event.item_id);
+        auto lost_object = lost_object_id ? lost_objects_.find(*lost_object_id) : lost_objects_.end();
+        if (lost_object != lost_objects_.end() && dogs_.Bag(slot).size() < m.GetSpecificBagCapacity()
+            && dogs_.AddToBag(slot, BagItem{ lost_object->second.GetId(), lost_object->second.GetType(), lost_object->second.GetScorePerObj() }))
         {
-            dogs_[event.gatherer_id].AddLoot(lost_objects_[event.item_id]);
-            lost_objects_.erase(event.item_id);
+            if (track_visibility)
+            {
+                lost_object_grid_.Erase(lost_object->first, Position{ lost_object->second.GetX(), lost_object->second.GetY() });
+            }
+            lost_objects_.erase(lost_object);
+            picked.push_back(*lost_object_id);
+            pending_.removed_lost_objects.push_back(*lost_object_id);
             loot_count_ -= 1;
         }
-        if (std::find(offices_in_items.begin(), offices_in_items.end(), event.item_id) != offices_in_items.end())
+        if (collision_world_.IsOffice(event.item_id))
         {
-            dogs_[event.gatherer_id].DropLoot();
+            auto& info = dogs_.Info(slot);
+            for (const auto& item : dogs_.Bag(slot))
+            {
+                info.score += item.value;
+            }
+            dogs_.ClearBag(slot);
         }
     }
-    
-    prov.Clear();
+    for (const auto id : picked)
+    {
+        collision_world_.RemoveLostObject(id);
+    }
+
+    std::vector<std::uint64_t> expired;
+    retirement_.Advance(dogs_.Now(), expired);
+    for (const auto id : expired)
+    {
+        retired_.push_back(GetDog(id));
+        RemoveDog(id);
+    }
+
+    cached_state_.reset();
+    pending_.tick = ++tick_;
+    history_.push_back(std::exchange(pending_, {}));
+    if (history_.size() > TICK_HISTORY)
+    {
+        history_.pop_front();
+    }
 }
-void GameSession::ProcessHorizontalRoad(model::Dog& d, const model::Road current_road, model::Position& pos, const model::Speed spd, const std::string& dir, double time_sec, const model::Map& m)
+template <Axis road_axis>
+void GameSession::MoveDog(size_t slot, double time_sec, const Map& m)
 {
-    auto r1_st = current_road.GetStart();
-    auto r1_fn = current_road.GetEnd();
-    double lesser_r1_x = (r1_st.x < r1_fn.x ? r1_st.x : r1_fn.x) - road_offset;
-    double greater_r1_x = (r1_st.x > r1_fn.x ? r1_st.x : r1_fn.x) + road_offset;
-    if (dir == "L")
+    constexpr Axis cross_axis = OtherAxis(road_axis);
+    const auto& roads = m.GetRoads();
+    const auto road_index = dogs_.Roads()[slot];
+    const Road& road = roads[road_index];
+    const Direction dir = dogs_.Directions()[slot];
+    const Speed spd = dogs_.Speeds()[slot];
+    Position& pos = dogs_.Positions()[slot];
+
+    if (IsAlong<road_axis>(dir))
     {
-        if (pos.x + spd.vx * time_sec <= lesser_r1_x)
+        if (!Advance(AxisOf<road_axis>(pos), AxisOf<road_axis>(spd) * time_sec, IsBackward(dir), LowerBound<road_axis>(road), UpperBound<road_axis>(road)))
         {
-            pos.x = lesser_r1_x;
-            d.SetSpeed(0.0, 0.0);
-        }
-        else
-        {
-            pos.x += (spd.vx * time_sec);
+            dogs_.Speeds()[slot] = Speed{};
         }
     }
-    else if (dir == "R")
+    else if (IsAlong<cross_axis>(dir))
     {
-        if (pos.x + spd.vx * time_sec >= greater_r1_x)
+        // turning is only possible inside a crossing, otherwise the dog stays within the road width
+        const Road* bounding_road = &road;
+        if (const auto* cross = m.FindCrossing(road_index, pos))
         {
-            pos.x = greater_r1_x;
-            d.SetSpeed(0.0, 0.0);
+            const auto other = cross->Other(road_index);
+            bounding_road = &roads[other];
+            dogs_.Roads()[slot] = static_cast<std::uint32_t>(other);
         }
-        else
+        if (!Advance(AxisOf<cross_axis>(pos), AxisOf<cross_axis>(spd) * time_sec, IsBackward(dir), LowerBound<cross_axis>(*bounding_road), UpperBound<cross_axis>(*bounding_road)))
         {
-            pos.x += (spd.vx * time_sec);
+            dogs_.Speeds()[slot] = Speed{};
         }
     }
-    else if (dir == "U" || dir == "D")
-    {
-        bool in_cross = false;
-        const auto& road_crosses = m.GetRoadCrossses(current_road);
-        for (const auto& cross : road_crosses)
-        {
-            double lb_x = cross.x - road_offset;
-            double rb_x = cross.x + road_offset;
-            double lb_y = cross.y - road_offset;
-            double rb_y = cross.y + road_offset;
-            if (lb_x <= pos.x && pos.x <= rb_x && lb_y <= pos.y && pos.y <= rb_y)
-            {
-                const auto& crossed_roads = m.GetNeighbourRoad(cross);
-                const Road* r1 = &crossed_roads.first;
-                const Road* r2 = &crossed_roads.second;
-                if (current_road == crossed_roads.first)
-                {
-                    d.SetRoad(r2);
-                }
-                else
-                {
-                    d.SetRoad(r1);
-                }
+}
+const Map& GameSession::GetMap() const { return *map_; }
+std::uint64_t GameSession::GetId() const { return id_; }
+const DogStorage& GameSession::GetDogs() const { return dogs_; }
+std::uint64_t GameSession::GetPlayersAmount() const { return dogs_.Size(); }
 
-                const auto& crossed_road = d.GetRoad();
+namespace {
 
-                auto r2_st = crossed_road.GetStart();
-                auto r2_fn = crossed_road.GetEnd();
-                double lesser_r2_y = (r2_st.y < r2_fn.y ? r2_st.y : r2_fn.y) - road_offset;
-                double greater_r2_y = (r2_st.y > r2_fn.y ? r2_st.y : r2_fn.y) + road_offset;
-                if (dir == "U")
-                {
-                    if (pos.y + spd.vy * time_sec <= lesser_r2_y)
-                    {
-                        pos.y = lesser_r2_y;
-                        d.SetSpeed(0.0, 0.0);
-                    }
-                    else
-                    {
-                        pos.y += (spd.vy * time_sec);
-                    }
-                }
-                else if (dir == "D")
-                {
-                    if (pos.y + spd.vy * time_sec >= greater_r2_y)
-                    {
-                        pos.y = greater_r2_y;
-                        d.SetSpeed(0.0, 0.0);
-                    }
-                    else
-                    {
-                        pos.y += (spd.vy * time_sec);
-                    }
-                }
+bool IsMoving(Speed spd) {
+    return spd.vx != 0.0 || spd.vy != 0.0;
+}
 
-                in_cross = true;
-                break;
-            }
-        }
-        if (!in_cross)
+}  // namespace
+
+size_t DogStorage::Add(const Dog& dog, std::uint32_t road) {
+    pos_.push_back(dog.GetPos());
+    spd_.push_back(dog.GetSpd());
+    dir_.push_back(dog.GetDir());
+    road_.push_back(road);
+    idle_since_.push_back(now_);
+    info_.push_back(DogInfo{ dog.GetName(), dog.GetId(), dog.GetScore(), dog.GetTime() });
+    const size_t slot = info_.size() - 1;
+    const auto& bag = dog.GetBag();
+    if (bag.size() > bag_capacity_)
+    {
+        // spread the existing bags out to the larger stride, last slot first
+        const size_t capacity = bag.size();
+        bag_items_.resize(info_.size() * capacity);
+        for (size_t s = slot; s-- > 0;)
         {
-            double upper_bound = r1_st.y - road_offset;
-            double lower_bound = r1_st.y + road_offset;
-            if (dir == "U")
-            {
-                if (pos.y + spd.vy * time_sec <= upper_bound)
-                {
-                    pos.y = upper_bound;
-                    d.SetSpeed(0.0, 0.0);
-                }
-                else
-                {
-                    pos.y += (spd.vy * time_sec);
-                }
-            }
-            else
-            {
-                if (pos.y + spd.vy * time_sec >= lower_bound)
-                {
-                    pos.y = lower_bound;
-                    d.SetSpeed(0.0, 0.0);
-                }
-                else
-                {
-                    pos.y += (spd.vy * time_sec);
-                }
-            }
+            std::copy_backward(bag_items_.begin() + s * bag_capacity_, bag_items_.begin() + s * bag_capacity_ + bag_size_[s], bag_items_.begin() + s * capacity + bag_size_[s]);
         }
+        bag_capacity_ = capacity;
     }
+    bag_items_.resize(info_.size() * bag_capacity_);
+    std::copy(bag.begin(), bag.end(), bag_items_.begin() + slot * bag_capacity_);
+    bag_size_.push_back(static_cast<std::uint32_t>(bag.size()));
+    id_to_slot_[dog.GetId()] = slot;
+    if (IsMoving(dog.GetSpd()))
+    {
+        active_.push_back(static_cast<std::uint32_t>(slot));
+    }
+    return slot;
 }
-void GameSession::ProcessVerticalRoad(model::Dog& d, const model::Road current_road, model::Position& pos, const model::Speed spd, const std::string& dir, double time_sec, const model::Map& m)
-{
-    auto r2_st = current_road.GetStart();
-    auto r2_fn = current_road.GetEnd();
-    double lesser_r2_y = (r2_st.y < r2_fn.y ? r2_st.y : r2_fn.y) - road_offset;
-    double greater_r2_y = (r2_st.y > r2_fn.y ? r2_st.y : r2_fn.y) + road_offset;
-    if (dir == "U")
+void DogStorage::Remove(size_t slot) {
+    // the last dog takes the freed slot, so nothing else moves
+    const size_t last = info_.size() - 1;
+    const bool last_active = std::binary_search(active_.begin(), active_.end(), static_cast<std::uint32_t>(last));
+    std::erase(active_, static_cast<std::uint32_t>(slot));
+    id_to_slot_.erase(info_[slot].id);
+    if (slot != last)
     {
-        if (pos.y + spd.vy * time_sec <= lesser_r2_y)
+        pos_[slot] = pos_[last];
+        spd_[slot] = spd_[last];
+        dir_[slot] = dir_[last];
+        road_[slot] = road_[last];
+        idle_since_[slot] = idle_since_[last];
+        info_[slot] = std::move(info_[last]);
+        std::copy_n(bag_items_.begin() + last * bag_capacity_, bag_size_[last], bag_items_.begin() + slot * bag_capacity_);
+        bag_size_[slot] = bag_size_[last];
+        id_to_slot_[info_[slot].id] = slot;
+        if (last_active)
         {
-            pos.y = lesser_r2_y;
-            d.SetSpeed(0.0, 0.0);
-        }
-        else
-        {
-            pos.y += (spd.vy * time_sec);
+            std::erase(active_, static_cast<std::uint32_t>(last));
+            active_.insert(std::lower_bound(active_.begin(), active_.end(), static_cast<std::uint32_t>(slot)), static_cast<std::uint32_t>(slot));
         }
     }
-    else if (dir == "D")
+    pos_.pop_back();
+    spd_.pop_back();
+    dir_.pop_back();
+    road_.pop_back();
+    idle_since_.pop_back();
+    info_.pop_back();
+    bag_size_.pop_back();
+    bag_items_.resize(info_.size() * bag_capacity_);
+}
+bool DogStorage::AddToBag(size_t slot, const BagItem& item) {
+    if (bag_size_[slot] >= bag_capacity_)
+    {
+        return false;
+    }
+    bag_items_[slot * bag_capacity_ + bag_size_[slot]++] = item;
+    return true;
+}
+void DogStorage::SetSpeed(size_t slot, Speed spd) {
+    spd_[slot] = spd;
+    if (IsMoving(spd))
     {
-        if (pos.y + spd.vy * time_sec >= greater_r2_y)
+        const auto s = static_cast<std::uint32_t>(slot);
+        if (auto it = std::lower_bound(active_.begin(), active_.end(), s); it == active_.end() || *it != s)
         {
-            pos.y = greater_r2_y;
-            d.SetSpeed(0.0, 0.0);
-        }
-        else
-        {
-            pos.y += (spd.vy * time_sec);
+            active_.insert(it, s);
         }
     }
-    else if (dir == "L" || dir == "R")
+}
+void DogStorage::SetDirection(size_t slot, Direction dir) {
+    if (dir_[slot] == Direction::NONE && dir != Direction::NONE)
     {
-        bool in_cross = false;
-        const auto& road_crosses = m.GetRoadCrossses(current_road);
-        for (const auto& cross : road_crosses)
-        {
-            double lb_x = cross.x - road_offset;
-            double rb_x = cross.x + road_offset;
-            double lb_y = cross.y - road_offset;
-            double rb_y = cross.y + road_offset;
-            if (lb_x <= pos.x && pos.x <= rb_x && lb_y <= pos.y && pos.y <= rb_y)
-            {
-                const auto& crossed_roads = m.GetNeighbourRoad(cross);
-                const Road* r1 = &crossed_roads.first;
-                const Road* r2 = &crossed_roads.second;
-                if (current_road == crossed_roads.first)
-                {
-                    d.SetRoad(r2);
-                }
-                else
-                {
-                    d.SetRoad(r1);
-                }
-
-                const auto& crossed_road = d.GetRoad();
-
-                auto r1_st = crossed_road.GetStart();
-                auto r1_fn = crossed_road.GetEnd();
-                double lesser_r1_x = (r1_st.x < r1_fn.x ? r1_st.x : r1_fn.x) - road_offset;
-                double greater_r1_x = (r1_st.x > r1_fn.x ? r1_st.x : r1_fn.x) + road_offset;
-                if (dir == "L")
-                {
-                    if (pos.x + spd.vx * time_sec <= lesser_r1_x)
-                    {
-                        pos.x = lesser_r1_x;
-                        d.SetSpeed(0.0, 0.0);
-                    }
-                    else
-                    {
-                        pos.x += (spd.vx * time_sec);
-                    }
-                }
-                else if (dir == "R")
-                {
-                    if (pos.x + spd.vx * time_sec >= greater_r1_x)
-                    {
-                        pos.x = greater_r1_x;
-                        d.SetSpeed(0.0, 0.0);
-                    }
-                    else
-                    {
-                        pos.x += (spd.vx * time_sec);
-                    }
-                }
+        info_[slot].time += now_ - idle_since_[slot];
+    }
+    else if (dir_[slot] != Direction::NONE && dir == Direction::NONE)
+    {
+        idle_since_[slot] = now_;
+    }
+    dir_[slot] = dir;
+}
+void DogStorage::DeactivateStopped() {
+    std::erase_if(active_, [this](std::uint32_t slot) { return !IsMoving(spd_[slot]); });
+}
+std::uint64_t DogStorage::IdleTime(size_t slot) const {
+    return info_[slot].time + (dir_[slot] == Direction::NONE ? now_ - idle_since_[slot] : 0);
+}
+std::optional<size_t> DogStorage::FindSlot(std::uint64_t id) const {
+    if (auto it = id_to_slot_.find(id); it != id_to_slot_.end())
+    {
+        return it->second;
+    }
+    return std::nullopt;
+}
+Dog DogStorage::Get(size_t slot, const Map& map) const {
+    const auto& info = info_[slot];
+    Dog dog{ info.name, info.id };
+    dog.Move(pos_[slot]);
+    dog.SetSpeed(spd_[slot].vx, spd_[slot].vy);
+    dog.SetDir(dir_[slot]);
+    dog.SetRoad(&map.GetRoads()[road_[slot]]);
+    for (const auto& item : Bag(slot))
+    {
+        dog.AddLoot(item);
+    }
+    dog.SetScore(info.score);
+    dog.SetTime(IdleTime(slot));
+    return dog;
+}
 
-                in_cross = true;
-                break;
-            }
+std::optional<TickChanges> GameSession::CollectChanges(std::uint64_t since) const {
+    const auto oldest = history_.empty() ? tick_ + 1 : history_.front().tick;
+    if (since > tick_ || since + 1 < oldest)
+    {
+        return std::nullopt;
+    }
+    TickChanges changes;
+    changes.tick = tick_;
+    auto append = [](std::vector<std::uint64_t>& to, const std::vector<std::uint64_t>& from) {
+        to.insert(to.end(), from.begin(), from.end());
+    };
+    auto merge = [&](const TickChanges& tick_changes) {
+        append(changes.dogs, tick_changes.dogs);
+        append(changes.removed_dogs, tick_changes.removed_dogs);
+        append(changes.lost_objects, tick_changes.lost_objects);
+        append(changes.removed_lost_objects, tick_changes.removed_lost_objects);
+    };
+    // ticks are consecutive, the first one after since is at a known offset
+    for (auto it = history_.begin() + (since + 1 - oldest); it != history_.end(); ++it)
+    {
+        merge(*it);
+    }
+    merge(pending_);
+    for (auto* ids : { &changes.dogs, &changes.removed_dogs, &changes.lost_objects, &changes.removed_lost_objects })
+    {
+        std::sort(ids->begin(), ids->end());
+        ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+    }
+    return changes;
+}
+void GameSession::CollectVisible(Position center, double radius, std::vector<size_t>& dog_slots, std::vector<std::uint64_t>& lost_object_ids) const {
+    auto in_range = [&](Position pos) {
+        const double dx = pos.x - center.x;
+        const double dy = pos.y - center.y;
+        return dx * dx + dy * dy <= radius * radius;
+    };
+    dog_grid_.ForEachNear(center, radius, [&](std::uint64_t id) {
+        if (auto slot = dogs_.FindSlot(id); slot && in_range(dogs_.Positions()[*slot]))
+        {
+            dog_slots.push_back(*slot);
         }
-        if (!in_cross)
+    });
+    lost_object_grid_.ForEachNear(center, radius, [&](std::uint64_t id) {
+        if (auto it = lost_objects_.find(id); it != lost_objects_.end() && in_range(Position{ it->second.GetX(), it->second.GetY() }))
         {
-            double left_bound = r2_st.x - road_offset;
-            double right_bound = r2_st.x + road_offset;
-            if (dir == "L")
-            {
-                if (pos.x + spd.vx * time_sec <= left_bound)
-                {
-                    pos.x = left_bound;
-                    d.SetSpeed(0.0, 0.0);
-                }
-                else
-                {
-                    pos.x += (spd.vx * time_sec);
-                }
-            }
-            else
-            {
-                if (pos.x + spd.vx * time_sec >= right_bound)
-                {
-                    pos.x = right_bound;
-                    d.SetSpeed(0.0, 0.0);
-                }
-                else
-                {
-                    pos.x += (spd.vx * time_sec);
-                }
-            }
+            lost_object_ids.push_back(id);
         }
+    });
+    // same order as a full listing
+    std::sort(dog_slots.begin(), dog_slots.end());
+}
+
+void SpatialGrid::Erase(std::uint64_t id, Position pos) {
+    auto it = cells_.find(CellKey(Cell(pos.x), Cell(pos.y)));
+    if (it == cells_.end())
+    {
+        return;
+    }
+    auto& ids = it->second;
+    if (auto found = std::find(ids.begin(), ids.end(), id); found != ids.end())
+    {
+        *found = ids.back();
+        ids.pop_back();
+    }
+    if (ids.empty())
+    {
+        cells_.erase(it);
     }
 }
-const Map& GameSession::GetMap() const { return *map_; }
-std::uint64_t GameSession::GetId() const { return id_; }
-const std::vector<Dog>& GameSession::GetDogs() const { return dogs_; }
-std::uint64_t GameSession::GetPlayersAmount() const { return dogs_.size(); }
+void SpatialGrid::Move(std::uint64_t id, Position from, Position to) {
+    if (Cell(from.x) == Cell(to.x) && Cell(from.y) == Cell(to.y))
+    {
+        return;
+    }
+    Erase(id, from);
+    Insert(id, to);
+}
 
 void SessionManager::Initialize(const std::vector<Map>& maps)
 {
     for (const auto& map : maps)
     {
-        active_sessions_.push_back(std::make_shared<GameSession>(&map, 0));
+        AddSession(std::make_shared<GameSession>(&map, 0));
     }
 }
+void SessionManager::AddSession(std::shared_ptr<GameSession> session)
+{
+    session->SetLootGenerator(loot_generator_);
+    session->SetRandomSeed(rng::SplitMix64(seed_state_));
+    session->SetRetirementTime(retirement_time_);
+    auto& map_sessions = sessions_by_map_[session->GetMap().GetId()];
+    if (map_sessions.size() <= session->GetId())
+    {
+        map_sessions.resize(session->GetId() + 1);
+    }
+    map_sessions[session->GetId()] = session;
+    active_sessions_.push_back(std::move(session));
+}
 std::shared_ptr<GameSession> SessionManager::FindSession(const Map* m, uint64_t session_id) const
 {
-    for (auto session : active_sessions_)
+    if (auto it = sessions_by_map_.find(m->GetId()); it != sessions_by_map_.end() && session_id < it->second.size())
+    {
+        return it->second[session_id];
+    }
+    return nullptr;
+}
+std::shared_ptr<GameSession> SessionManager::JoinSession(const Map* m)
+{
+    const auto& map_sessions = sessions_by_map_[m->GetId()];
+    std::shared_ptr<GameSession> least_loaded;
+    for (const auto& session : map_sessions)
     {
-        if (m->GetId() == (session->GetMap()).GetId() && session_id == session->GetId())
+        if (session && (!least_loaded || session->GetPlayersAmount() < least_loaded->GetPlayersAmount()))
         {
-            return session;
+            least_loaded = session;
         }
     }
+    const auto capacity = m->GetSessionCapacity();
+    if (!least_loaded || (capacity != 0 && least_loaded->GetPlayersAmount() >= capacity))
+    {
+        least_loaded = std::make_shared<GameSession>(m, map_sessions.size());
+        AddSession(least_loaded);
+    }
+    return least_loaded;
+}
+void SessionManager::SetTickThreads(unsigned threads)
+{
+    if (tick_pool_)
+    {
+        tick_pool_->join();
+    }
+    tick_pool_ = threads > 1 ? std::make_shared<boost::asio::thread_pool>(threads) : nullptr;
+    tick_threads_ = std::max(threads, 1u);
 }
-void SessionManager::UpdateAllSessions(std::uint64_t time, loot_gen::LootGenerator lg) const {
+void SessionManager::UpdateAllSessions(std::uint64_t time) const {
+    if (!tick_pool_ || active_sessions_.size() < 2)
+    {
+        // an idle pool still helps a lone session with its collisions
+        for (auto session_p : active_sessions_)
+        {
+            session_p->UpdateSession(time, tick_pool_.get(), tick_threads_);
+        }
+        return;
+    }
+    // Sessions share only the read-only map, each one is updated by its own task.
+    // The caller waits for all of them, so players are synchronized with finished sessions only.
+    std::latch done(static_cast<std::ptrdiff_t>(active_sessions_.size()));
+    std::mutex error_mutex;
+    std::exception_ptr error;
     for (auto session_p : active_sessions_)
     {
-        session_p->UpdateSession(time, lg);
+        boost::asio::post(*tick_pool_, [&, session_p]() {
+            try
+            {
+                session_p->UpdateSession(time);
+            }
+            catch (...)
+            {
+                std::lock_guard lock{ error_mutex };
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+            done.count_down();
+        });
+    }
+    done.wait();
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+CollisionWorld::CollisionWorld(const std::vector<Office>& offices) : offices_count_(offices.size()), lanes_(collision_lane_width) {
+    for (const auto& office : offices)
+    {
+        const auto office_pos = office.GetPosition();
+        items_.push_back(collision_detector::Item{ geom::Point2D{ static_cast<double>(office_pos.x), static_cast<double>(office_pos.y) }, base_width });
+        lanes_.Insert(items_.size() - 1, items_.back().position);
     }
 }
 
-TestItemGathererProvider::TestItemGathererProvider() {
+void CollisionWorld::AddLostObject(std::uint64_t id, Position pos) {
+    if (id_to_item_.contains(id))
+    {
+        RemoveLostObject(id);
+    }
+    items_.push_back(collision_detector::Item{ geom::Point2D{ pos.x, pos.y }, item_width });
+    lost_object_ids_.push_back(id);
+    id_to_item_[id] = items_.size() - 1;
+    lanes_.Insert(items_.size() - 1, items_.back().position);
 }
 
-std::vector<int> TestItemGathererProvider::Initialize(const std::unordered_map<std::uint64_t, model::LostObject>& items, const std::vector<std::pair<Position, Position>>& gatherers, const std::vector<model::Office>& offices) {
-    std::vector<int> offices_in_items;
-    items_.resize(items.size() + offices.size());
-    for (auto it = items.begin(); it != items.end(); it++)
+void CollisionWorld::RemoveLostObject(std::uint64_t id) {
+    auto it = id_to_item_.find(id);
+    if (it == id_to_item_.end())
     {
-        items_[it->first] = collision_detector::Item{ geom::Point2D{ it->second.GetX(), it->second.GetY() }, item_width };
+        return;
     }
-    for (int i = items.size(), j = 0; i < items_.size(); i++, j++)
+    const size_t idx = it->second;
+    const size_t last = items_.size() - 1;
+    id_to_item_.erase(it);
+    lanes_.Erase(idx, items_[idx].position);
+    if (idx != last)
     {
-        auto office_pos = offices[j].GetPosition();
-        items_[i] = collision_detector::Item{ geom::Point2D{ static_cast<double>(office_pos.x), static_cast<double>(office_pos.y)}, base_width};
-        offices_in_items.push_back(i);
+        lanes_.Erase(last, items_[last].position);
+        items_[idx] = items_[last];
+        lost_object_ids_[idx - offices_count_] = lost_object_ids_[last - offices_count_];
+        id_to_item_[lost_object_ids_[idx - offices_count_]] = idx;
+        lanes_.Insert(idx, items_[idx].position);
     }
-    for (int i=0; i<gatherers.size(); i++)
+    items_.pop_back();
+    lost_object_ids_.pop_back();
+}
+
+void CollisionWorld::AddGatherer(Position from, Position to) {
+    gatherers_.push_back(collision_detector::Gatherer{ geom::Point2D{ from.x, from.y }, geom::Point2D{ to.x, to.y }, gatherer_width });
+}
+
+std::vector<collision_detector::GatheringEvent> CollisionWorld::FindGatherEvents(boost::asio::thread_pool* pool, unsigned threads) const {
+    if (pool)
     {
-        gatherers_.emplace_back(geom::Point2D{gatherers[i].first.x, gatherers[i].first.y}, geom::Point2D{ gatherers[i].second.x, gatherers[i].second.y }, gatherer_width);
+        return collision_detector::FindGatherEvents(items_, gatherers_, lanes_, std::max(item_width, base_width), *pool, threads);
     }
-    return offices_in_items;
+    return collision_detector::FindGatherEvents(items_, gatherers_, lanes_, std::max(item_width, base_width));
 }
 
-void TestItemGathererProvider::Clear() {
-    items_.clear();
-    gatherers_.clear();
+std::optional<std::uint64_t> CollisionWorld::GetLostObjectId(size_t idx) const {
+    if (idx >= offices_count_ && idx < items_.size())
+    {
+        return lost_object_ids_[idx - offices_count_];
+    }
+    return std::nullopt;
 }
 
-size_t TestItemGathererProvider::ItemsCount() const {
+size_t CollisionWorld::ItemsCount() const {
     return items_.size();
 }
 
-collision_detector::Item TestItemGathererProvider::GetItem(size_t idx) const {
+collision_detector::Item CollisionWorld::GetItem(size_t idx) const {
     return items_.at(idx);
 }
 
-size_t TestItemGathererProvider::GatherersCount() const {
+size_t CollisionWorld::GatherersCount() const {
     return gatherers_.size();
 }
 
-collision_detector::Gatherer TestItemGathererProvider::GetGatherer(size_t idx) const {
+collision_detector::Gatherer CollisionWorld::GetGatherer(size_t idx) const {
     return gatherers_.at(idx);
 }
 
@@ -611,6 +958,7 @@ const Map::Offices& Map::GetOffices() const noexcept {
 }
 
 void Map::AddRoad(const Road& road) {
+    road_id_to_index_.emplace(road.GetId(), roads_.size());
     roads_.emplace_back(road);
 }
 
@@ -634,12 +982,67 @@ std::uint64_t Map::GetSpecificBagCapacity() const {
     return bag_capacity_;
 }
 
-const std::vector<Point>& Map::GetRoadCrossses(const Road& road) const {
-    return roads_to_crosses_.at(road);
+void Map::AddSessionCapacity(std::uint64_t session_capacity) {
+    session_capacity_ = session_capacity;
+}
+
+void Map::AddViewRadius(double view_radius) {
+    view_radius_ = view_radius;
+}
+
+double Map::GetViewRadius() const {
+    return view_radius_;
+}
+
+std::uint64_t Map::GetSessionCapacity() const {
+    return session_capacity_;
+}
+
+void Map::AddLootType(LootType loot_type) {
+    loot_types_json_.pop_back();
+    if (!loot_types_.empty())
+    {
+        loot_types_json_ += ',';
+    }
+    loot_types_json_ += loot_type.frontend_json;
+    loot_types_json_ += ']';
+    loot_types_.push_back(std::move(loot_type));
 }
 
-const std::pair<Road, Road>& Map::GetNeighbourRoad(const Point& cross) const {
-    return grid_.at(cross);
+const std::vector<LootType>& Map::GetLootTypes() const noexcept {
+    return loot_types_;
+}
+
+const std::string& Map::GetLootTypesJson() const noexcept {
+    return loot_types_json_;
+}
+
+const Map::Crossings& Map::GetCrossings() const noexcept {
+    return crossings_;
+}
+
+const std::vector<size_t>& Map::GetRoadCrossings(size_t road) const {
+    return road_crossings_.at(road);
+}
+
+const RoadCrossing* Map::FindCrossing(size_t road, Position pos) const {
+    const auto& ids = road_crossings_.at(road);
+    const bool horizontal = roads_[road].IsHorizontal();
+    const double along = horizontal ? pos.x : pos.y;
+    auto along_coord = [&](size_t c) {
+        return horizontal ? crossings_[c].point.x : crossings_[c].point.y;
+    };
+    // ids are sorted along the road: skip crossings lying entirely behind pos, then check the few that may contain it
+    auto it = std::partition_point(ids.begin(), ids.end(), [&](size_t c) { return along_coord(c) + road_offset < along; });
+    for (; it != ids.end() && along_coord(*it) - road_offset <= along; ++it)
+    {
+        const auto& cross = crossings_[*it].point;
+        if (cross.x - road_offset <= pos.x && pos.x <= cross.x + road_offset && cross.y - road_offset <= pos.y && pos.y <= cross.y + road_offset)
+        {
+            return &crossings_[*it];
+        }
+    }
+    return nullptr;
 }
 
 void Game::AddDefaultDogSpeed(double speed) {
@@ -658,6 +1061,14 @@ std::uint64_t Game::GetDefaultBagCapacity() const {
     return def_bag_capacity_;
 }
 
+void Game::AddDefaultSessionCapacity(std::uint64_t def_session_capacity) {
+    def_session_capacity_ = def_session_capacity;
+}
+
+std::uint64_t Game::GetDefaultSessionCapacity() const {
+    return def_session_capacity_;
+}
+
 const Game::Maps& Game::GetMaps() const noexcept {
     return maps_;
 }
@@ -683,18 +1094,18 @@ std::uint64_t Dog::GetId() const { return id_; }
 std::uint64_t Dog::GetScore() const { return score_; }
 Position Dog::GetPos() const { return pos_; }
 Speed Dog::GetSpd() const { return spd_; }
-const std::string& Dog::GetDir() const { return dir_; }
-void Dog::SetDir(std::string dir) { dir_ = dir; }
+Direction Dog::GetDir() const { return dir_; }
+void Dog::SetDir(Direction dir) { dir_ = dir; }
 void Dog::SetSpeed(double vxx, double vyy) { spd_.vx = vxx; spd_.vy = vyy; }
 void Dog::Move(Position pos) { pos_ = pos; }
 const Road& Dog::GetRoad() const { return *r_; }
 void Dog::SetRoad(const Road* r) { r_ = r; }
-void Dog::AddLoot(const LostObject& obj) { bag_.push_back(obj); }
-const std::vector<LostObject>& Dog::GetBag() const { return bag_; }
+void Dog::AddLoot(const BagItem& item) { bag_.push_back(item); }
+const Dog::Bag& Dog::GetBag() const { return bag_; }
 void Dog::DropLoot() {
     for (const auto& item : bag_)
     {
-        score_ += item.GetScorePerObj();
+        score_ += item.value;
     }
     bag_.clear();
 }
@@ -8,9 +8,17 @@
 #include <cmath>
 #include <optional>
 #include <iostream>
+#include <string_view>
+#include <utility>
+#include <deque>
+#include <span>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/container/small_vector.hpp>
 #include "tagged.h"
+#include "rng.h"
 #include "loot_generator.h"
 #include "collision_detector.h"
+#include "timer_wheel.h"
 
 namespace model {
 
@@ -24,6 +32,22 @@ struct Speed {
     double vy = 0.0;
 };
 
+enum class Axis : std::uint8_t {
+    X,
+    Y
+};
+
+enum class Direction : std::uint8_t {
+    UP,
+    DOWN,
+    LEFT,
+    RIGHT,
+    NONE
+};
+
+Direction DirectionFromString(std::string_view dir);
+std::string_view DirectionToString(Direction dir);
+
 using Dimension = int;
 using Coord = Dimension;
 
@@ -34,12 +58,6 @@ struct Point {
     Coord x, y;
 };
 
-struct PointHasher {
-    size_t operator()(const Point& p) const {
-        return std::hash<int>{}(p.x) + std::hash<int>{}(p.y);
-    }
-};
-
 struct Size {
     Dimension width, height;
 };
@@ -83,15 +101,14 @@ private:
     Id id_;
 };
 
-struct RoadHasher {
-    size_t operator()(const Road& r) const {
-        auto start = r.GetStart();
-        auto end = r.GetEnd();
-        return std::hash<int>{}(start.x) + std::hash<int>{}(start.y) + std::hash<int>{}(end.x) + std::hash<int>{}(end.y);
-    }
-};
+// Point where a horizontal and a vertical road meet, roads are indices in Map::GetRoads()
+struct RoadCrossing {
+    Point point;
+    size_t horizontal;
+    size_t vertical;
 
-std::optional<Point> IsIntersect(const Road& r1, const Road& r2);
+    size_t Other(size_t road) const { return road == horizontal ? vertical : horizontal; }
+};
 
 class Building {
 public:
@@ -117,12 +134,19 @@ private:
     Offset offset_;
 };
 
+struct LootType {
+    std::string name;
+    int value = 0;
+    std::string frontend_json;  // the loot type object as the frontend receives it
+};
+
 class Map {
 public:
     using Id = util::Tagged<std::string, Map>;
     using Roads = std::vector<Road>;
     using Buildings = std::vector<Building>;
     using Offices = std::vector<Office>;
+    using Crossings = std::vector<RoadCrossing>;
 
     Map(Id id, std::string name) noexcept;
     const Id& GetId() const noexcept;
@@ -135,38 +159,56 @@ public:
     void AddOffice(Office office);
     void AddSpecificMapDogSpeed(double speed);
     void AddSpecificBagCapacity(std::uint64_t bag_capacity);
+    void AddSessionCapacity(std::uint64_t session_capacity);
+    void AddViewRadius(double view_radius);
+    void AddLootType(LootType loot_type);
+    const std::vector<LootType>& GetLootTypes() const noexcept;
+    // JSON array of all loot types, kept up to date by AddLootType
+    const std::string& GetLootTypesJson() const noexcept;
     double GetSpecificMapDogSpeed() const;
     std::uint64_t GetSpecificBagCapacity() const;
-    std::pair<const Road*, Position> GetRandomPosition(bool randomize_spawn_points) const;
+    // Players per session before joins open another one, 0 for no limit
+    std::uint64_t GetSessionCapacity() const;
+    // Players see only dogs and loot this close to their own dog, 0 to see everything
+    double GetViewRadius() const;
+    std::pair<const Road*, Position> GetRandomPosition(bool randomize_spawn_points, rng::Xoshiro256& random) const;
     void CreateRoadGrid();
-    const std::vector<Point>& GetRoadCrossses(const Road& road) const;
-    const std::pair<Road, Road>& GetNeighbourRoad(const Point& cross) const;
+    const Crossings& GetCrossings() const noexcept;
+    // Indices into GetCrossings(), sorted by coordinate along the road
+    const std::vector<size_t>& GetRoadCrossings(size_t road) const;
+    // Crossing of the road whose square contains pos, nullptr if the position is between crossings
+    const RoadCrossing* FindCrossing(size_t road, Position pos) const;
     const Road* FindRoad(model::Road::Id id) const {
-        for (const auto& road : roads_)
+        if (auto it = road_id_to_index_.find(id); it != road_id_to_index_.end())
         {
-            if (road.GetId() == id)
-            {
-                return &road;
-            }
+            return &roads_[it->second];
         }
         return nullptr;
     }
+    std::uint32_t GetRoadIndex(const Road& road) const { return static_cast<std::uint32_t>(road_id_to_index_.at(road.GetId())); }
 
 private:
     using OfficeIdToIndex = std::unordered_map<Office::Id, size_t, util::TaggedHasher<Office::Id>>;
+    using RoadIdToIndex = std::unordered_map<Road::Id, size_t, util::TaggedHasher<Road::Id>>;
 
     Id id_;
     std::string name_;
     Roads roads_;
-    std::unordered_map<Point, std::pair<Road, Road>, PointHasher> grid_;
-    std::unordered_map<Road, std::vector<Point>, RoadHasher> roads_to_crosses_;
+    RoadIdToIndex road_id_to_index_;
+    Crossings crossings_;
+    std::vector<std::vector<size_t>> road_crossings_;
     Buildings buildings_;
 
     OfficeIdToIndex warehouse_id_to_index_;
     Offices offices_;
 
+    std::vector<LootType> loot_types_;
+    std::string loot_types_json_ = "[]";
+
     double specific_map_dog_speed_=0.0;
     std::uint64_t bag_capacity_ = 0;
+    std::uint64_t session_capacity_ = 0;
+    double view_radius_ = 0.0;
 };
 
 class Game {
@@ -176,8 +218,10 @@ public:
     void AddMap(Map map);
     void AddDefaultDogSpeed(double speed);
     void AddDefaultBagCapacity(std::uint64_t def_bag_capacity);
+    void AddDefaultSessionCapacity(std::uint64_t def_session_capacity);
     double GetDefaultDogSpeed() const;
     std::uint64_t GetDefaultBagCapacity() const;
+    std::uint64_t GetDefaultSessionCapacity() const;
     const Maps& GetMaps() const noexcept;
     const Map* FindMap(const Map::Id& id) const noexcept;
     void AddRetTime(double ret_time) { def_ret_time_ = ret_time; }
@@ -191,6 +235,7 @@ private:
     MapIdToIndex map_id_to_index_;
     double default_dog_speed_=1.0;
     std::uint64_t def_bag_capacity_ = 3;
+    std::uint64_t def_session_capacity_ = 0;
     double def_ret_time_ = 60.0;
 };
 
@@ -212,8 +257,18 @@ public:
     int score_per_obj_ = 0;
 };
 
+// What a bag keeps of a collected lost object
+struct BagItem {
+    std::uint64_t id = 0;
+    int type = 0;
+    int value = 0;
+};
+
 class Dog {
 public:
+    // bags rarely hold more than a few items, those stay inside the dog
+    using Bag = boost::container::small_vector<BagItem, 3>;
+
     Dog() = default;
     Dog(std::string name, Position pos, const Road* r);
     Dog(std::string name, std::uint64_t id);
@@ -223,14 +278,14 @@ public:
     std::uint64_t GetScore() const;
     Position GetPos() const;
     Speed GetSpd() const;
-    const std::string& GetDir() const;
-    void SetDir(std::string dir);
+    Direction GetDir() const;
+    void SetDir(Direction dir);
     void SetSpeed(double vxx, double vyy);
     void Move(Position pos);
     const Road& GetRoad() const;
     void SetRoad(const Road* r);
-    void AddLoot(const LostObject& obj);
-    const std::vector<LostObject>& GetBag() const;
+    void AddLoot(const BagItem& item);
+    const Bag& GetBag() const;
     void DropLoot();
     bool CanLoot(std::uint64_t max);
     void SetScore(std::uint64_t score) { score_ = score; }
@@ -244,65 +299,258 @@ private:
     Position pos_;
     const Road* r_ = nullptr;
     Speed spd_;
-    std::string dir_ = "U";
-    std::vector<LostObject> bag_;
+    Direction dir_ = Direction::UP;
+    Bag bag_;
     std::uint64_t score_ = 0;
     std::uint64_t time_ = 0;
 };
 
-class TestItemGathererProvider : public collision_detector::ItemGathererProvider {
+// Session-owned dog storage laid out as structure of arrays.
+// Data touched every tick (position, speed, direction, road) lives in
+// contiguous arrays; name and score are kept aside in DogInfo.
+// Bags share one pool with a fixed number of items per slot.
+// All arrays are addressed by the same slot index.
+class DogStorage {
 public:
-    TestItemGathererProvider();
-    std::vector<int> Initialize(const std::unordered_map<std::uint64_t, model::LostObject>& items, const std::vector<std::pair<Position, Position>>& gatherers, const std::vector<model::Office>& offices);
-    void Clear();
+    struct DogInfo {
+        std::string name;
+        std::uint64_t id = 0;
+        std::uint64_t score = 0;
+        std::uint64_t time = 0;  // idle time accumulated before the current idle period, see IdleTime
+    };
+
+    explicit DogStorage(size_t bag_capacity = 0) : bag_capacity_(bag_capacity) {}
+
+    size_t Size() const { return info_.size(); }
+    size_t Add(const Dog& dog, std::uint32_t road);
+    // Moves the last dog into the freed slot: slots are not stable across removals, dog ids are
+    void Remove(size_t slot);
+    std::optional<size_t> FindSlot(std::uint64_t id) const;
+    Dog Get(size_t slot, const Map& map) const;
+
+    std::vector<Position>& Positions() { return pos_; }
+    const std::vector<Position>& Positions() const { return pos_; }
+    std::vector<Speed>& Speeds() { return spd_; }
+    const std::vector<Speed>& Speeds() const { return spd_; }
+    const std::vector<Direction>& Directions() const { return dir_; }
+    std::vector<std::uint32_t>& Roads() { return road_; }
+    const std::vector<std::uint32_t>& Roads() const { return road_; }
+    DogInfo& Info(size_t slot) { return info_[slot]; }
+    const DogInfo& Info(size_t slot) const { return info_[slot]; }
+    std::span<const BagItem> Bag(size_t slot) const { return { bag_items_.data() + slot * bag_capacity_, bag_size_[slot] }; }
+    // false if the bag is full
+    bool AddToBag(size_t slot, const BagItem& item);
+    void ClearBag(size_t slot) { bag_size_[slot] = 0; }
+
+    // A moving dog becomes active, an active one stays so until DeactivateStopped finds it stopped
+    void SetSpeed(size_t slot, Speed spd);
+    // Switching to and from NONE opens and closes an idle period on the storage clock
+    void SetDirection(size_t slot, Direction dir);
+    // Slots of dogs that may move this tick, sorted so gathering ties resolve by slot
+    const std::vector<std::uint32_t>& Active() const { return active_; }
+    void DeactivateStopped();
+    void AdvanceClock(std::uint64_t time) { now_ += time; }
+    std::uint64_t Now() const { return now_; }
+    std::uint64_t IdleTime(size_t slot) const;
+
+private:
+    std::vector<Position> pos_;
+    std::vector<Speed> spd_;
+    std::vector<Direction> dir_;
+    std::vector<std::uint32_t> road_;
+    std::vector<std::uint64_t> idle_since_;
+    std::vector<DogInfo> info_;
+    size_t bag_capacity_;  // grows if a restored dog carries more than the map allows
+    std::vector<BagItem> bag_items_;  // bag_capacity_ items per slot
+    std::vector<std::uint32_t> bag_size_;
+    std::vector<std::uint32_t> active_;
+    std::unordered_map<std::uint64_t, size_t> id_to_slot_;
+    std::uint64_t now_ = 0;
+};
+
+// Items and gatherers of a session for collision_detector, kept across ticks.
+// Offices take the first item indices, lost objects follow them densely and stay in the grid
+// from spawn to pickup, so a tick only has to refill the gatherers.
+class CollisionWorld : public collision_detector::ItemGathererProvider {
+public:
+    explicit CollisionWorld(const std::vector<Office>& offices);
+    void AddLostObject(std::uint64_t id, Position pos);
+    // The last lost object takes the freed item index
+    void RemoveLostObject(std::uint64_t id);
+    void ClearGatherers() { gatherers_.clear(); }
+    void AddGatherer(Position from, Position to);
+    // Searched on pool when it is given
+    std::vector<collision_detector::GatheringEvent> FindGatherEvents(boost::asio::thread_pool* pool = nullptr, unsigned threads = 1) const;
     size_t ItemsCount() const override;
     collision_detector::Item GetItem(size_t idx) const override;
     size_t GatherersCount() const override;
     collision_detector::Gatherer GetGatherer(size_t idx) const override;
+    bool IsOffice(size_t idx) const { return idx < offices_count_; }
+    // Id of the lost object stored at the item index, nullopt for offices
+    std::optional<std::uint64_t> GetLostObjectId(size_t idx) const;
 private:
-    std::vector< collision_detector::Item> items_;
-    std::vector< collision_detector::Gatherer> gatherers_;
+    std::vector<collision_detector::Item> items_;
+    size_t offices_count_;
+    std::vector<std::uint64_t> lost_object_ids_;  // of items_[offices_count_ + i]
+    std::unordered_map<std::uint64_t, size_t> id_to_item_;
+    collision_detector::LaneIndex lanes_;  // dogs only move along roads
+    std::vector<collision_detector::Gatherer> gatherers_;
 };
 
-class GameSession {
+// Uniform grid of ids bucketed by position, cells are cell_size wide.
+// Only cells holding ids are kept, so the grid follows what is on the map and not where it has been.
+class SpatialGrid {
+public:
+    explicit SpatialGrid(double cell_size) : cell_size_(cell_size) {}
+    void Insert(std::uint64_t id, Position pos) { cells_[CellKey(Cell(pos.x), Cell(pos.y))].push_back(id); }
+    // pos is where id was inserted or last moved to
+    void Erase(std::uint64_t id, Position pos);
+    // Rebuckets id only if it crossed into another cell
+    void Move(std::uint64_t id, Position from, Position to);
+    // Calls f with the ids of all cells touching the square around center, exact distances are up to the caller
+    template <typename Fn>
+    void ForEachNear(Position center, double radius, Fn&& f) const {
+        for (auto cx = Cell(center.x - radius); cx <= Cell(center.x + radius); ++cx)
+        {
+            for (auto cy = Cell(center.y - radius); cy <= Cell(center.y + radius); ++cy)
+            {
+                if (auto it = cells_.find(CellKey(cx, cy)); it != cells_.end())
+                {
+                    for (const auto id : it->second)
+                    {
+                        f(id);
+                    }
+                }
+            }
+        }
+    }
+private:
+    std::int32_t Cell(double coord) const { return static_cast<std::int32_t>(std::floor(coord / cell_size_)); }
+    static std::uint64_t CellKey(std::int32_t cx, std::int32_t cy) {
+        return (std::uint64_t{ static_cast<std::uint32_t>(cx) } << 32) | static_cast<std::uint32_t>(cy);
+    }
 
-    const std::string VALUE = "value";
+    double cell_size_;
+    std::unordered_map<std::uint64_t, std::vector<std::uint64_t>> cells_;
+};
+
+// Ids of what changed during one session tick, state requests replay them instead of sending everything
+struct TickChanges {
+    std::uint64_t tick = 0;
+    std::vector<std::uint64_t> dogs;  // added, moved, turned, or with a new bag or score
+    std::vector<std::uint64_t> removed_dogs;
+    std::vector<std::uint64_t> lost_objects;  // spawned
+    std::vector<std::uint64_t> removed_lost_objects;
+};
 
+class GameSession {
 public:
     GameSession(const Map* map, std::uint64_t id);
+    // sessions are shared through pointers and references, a copy is always a mistake
+    GameSession(const GameSession&) = delete;
+    GameSession& operator=(const GameSession&) = delete;
+    GameSession(GameSession&&) = default;
+    GameSession& operator=(GameSession&&) = default;
     void AddDog(Dog d);
-    Dog& FindDog(std::string name, std::uint64_t id);
-    void UpdateSession(std::uint64_t time, loot_gen::LootGenerator lg);
+    Dog GetDog(std::uint64_t id) const;
+    std::uint64_t GetDogIdleTime(std::uint64_t id) const;
+    void SetDogDir(std::uint64_t id, Direction dir);
+    void SetDogSpeed(std::uint64_t id, Speed spd);
+    // Collisions of big sessions are searched on collision_pool split into collision_threads parts,
+    // the pool must not be the one running this call
+    void UpdateSession(std::uint64_t time, boost::asio::thread_pool* collision_pool = nullptr, unsigned collision_threads = 1);
+    // Number of finished ticks
+    std::uint64_t GetTick() const { return tick_; }
+    // Everything changed after tick since, including changes made after the last tick.
+    // nullopt if since is in the future or older than the kept history, the caller then needs a full state.
+    std::optional<TickChanges> CollectChanges(std::uint64_t since) const;
+    // Serialized full state shared by all state requests until the session changes, nullptr once stale
+    std::shared_ptr<const std::string> GetCachedState() const { return cached_state_; }
+    void CacheState(std::shared_ptr<const std::string> state) const { cached_state_ = std::move(state); }
+    void SetLootGenerator(loot_gen::LootGenerator lg) { loot_generator_ = std::move(lg); }
+    // Seeds spawn points and the loot generator, call it after SetLootGenerator
+    void SetRandomSeed(std::uint64_t seed) {
+        random_ = rng::Xoshiro256{ seed };
+        loot_generator_.SetRandomGenerator(loot_gen::UniformRandom{ random_() });
+    }
+    std::pair<const Road*, Position> GetSpawnPosition(bool randomize_spawn_points);
     const Map& GetMap() const;
     std::uint64_t GetId() const;
-    const std::vector<Dog>& GetDogs() const;
+    const DogStorage& GetDogs() const;
     const std::unordered_map<std::uint64_t, LostObject>& GetLostObjects() const;
     void AddLostObject(std::uint64_t id, LostObject obj);
+    // Slots of dogs and ids of lost objects within radius of center, looked up in grids refreshed every tick
+    void CollectVisible(Position center, double radius, std::vector<size_t>& dog_slots, std::vector<std::uint64_t>& lost_object_ids) const;
     std::uint64_t GetPlayersAmount() const;
     int GetLootCount() const;
-    void ProcessHorizontalRoad(model::Dog& d, const model::Road current_road, model::Position& pos, const model::Speed spd, const std::string& dir, double time_sec, const model::Map& m);
-    void ProcessVerticalRoad(model::Dog& d, const model::Road current_road, model::Position& pos, const model::Speed spd, const std::string& dir, double time_sec, const model::Map& m);
     void SetLootCount(int loot_count) { loot_count_ = loot_count; }
-    void RemoveDog(std::string name, std::uint64_t id);
+    void RemoveDog(std::uint64_t id);
+    // Dogs idle for at least time ms are removed by UpdateSession and handed out by TakeRetiredDogs
+    void SetRetirementTime(std::uint64_t time);
+    std::vector<Dog> TakeRetiredDogs() { return std::exchange(retired_, {}); }
 private:
+    size_t GetDogSlot(std::uint64_t id) const;
+    // Keeps the retirement deadline of the dog in slot in line with its direction and idle time
+    void ScheduleRetirement(size_t slot);
+    // Moves the dog in slot along a road lying on road_axis, turning at crossings.
+    template <Axis road_axis>
+    void MoveDog(size_t slot, double time_sec, const Map& m);
+    // true if state requests filter by a view radius, only then dog_grid_ and lost_object_grid_ are kept
+    bool HasViewRadius() const { return map_->GetViewRadius() > 0; }
+
     const Map* map_;
     std::uint64_t id_;
-    std::vector<Dog> dogs_;
+    DogStorage dogs_;
     std::unordered_map<std::uint64_t, LostObject> lost_objects_;
     int loot_count_ = 0;
-    TestItemGathererProvider prov{};
+    // spawns nothing until the session manager hands over the configured generator
+    loot_gen::LootGenerator loot_generator_{ loot_gen::LootGenerator::TimeInterval{ 1000 }, 0.0 };
+    CollisionWorld collision_world_;
+    rng::Xoshiro256 random_;
+    // nobody retires until the session manager sets the configured time
+    std::optional<std::uint64_t> retirement_time_;
+    timer_wheel::TimerWheel retirement_;  // keyed by dog id, runs on the dogs_ clock
+    std::vector<Dog> retired_;
+    // keyed by dog id and lost object id, updated as dogs move and objects spawn or get picked;
+    // left empty on maps without a view radius
+    SpatialGrid dog_grid_;
+    SpatialGrid lost_object_grid_;
+    static constexpr size_t TICK_HISTORY = 64;
+    std::uint64_t tick_ = 0;
+    std::deque<TickChanges> history_;  // the last TICK_HISTORY ticks, oldest first
+    TickChanges pending_;  // changes since the last tick, they become part of the next one
+    // dropped by everything that adds to pending_ and by ticks
+    mutable std::shared_ptr<const std::string> cached_state_;
 };
 
 class SessionManager {
 public:
-    SessionManager() = default;
+    // seed makes loot spawning and spawn points reproducible, every session derives its own one from it
+    SessionManager(loot_gen::LootGenerator lg, std::uint64_t seed, std::uint64_t retirement_time)
+        : loot_generator_(std::move(lg)), seed_state_(seed), retirement_time_(retirement_time) {}
     void Initialize(const std::vector<Map>& maps);
+    // Sessions are updated on a pool of the given size, with 1 they are updated on the calling thread
+    void SetTickThreads(unsigned threads);
+    // nullptr if the map has no session with this id
     std::shared_ptr<GameSession> FindSession(const Map* m, uint64_t session_id) const;
-    void UpdateAllSessions(std::uint64_t time, loot_gen::LootGenerator lg) const;
+    // The least loaded session of the map, a new one if all of them are full
+    std::shared_ptr<GameSession> JoinSession(const Map* m);
+    void UpdateAllSessions(std::uint64_t time) const;
     std::vector<std::shared_ptr<GameSession>> GetAllSessions() const { return active_sessions_; }
-    void AddSession(std::shared_ptr<GameSession> session) { active_sessions_.push_back(session); }
+    // Every session gets its own copy of the configured loot generator and its own random seed
+    void AddSession(std::shared_ptr<GameSession> session);
 private:
+    using MapIdHasher = util::TaggedHasher<Map::Id>;
+    // sessions of a map indexed by session id, ids without a session hold nullptr
+    using MapSessions = std::vector<std::shared_ptr<GameSession>>;
+
+    loot_gen::LootGenerator loot_generator_;
+    std::uint64_t seed_state_;
+    std::uint64_t retirement_time_;
     std::vector<std::shared_ptr<GameSession>> active_sessions_;
+    std::unordered_map<Map::Id, MapSessions, MapIdHasher> sessions_by_map_;
+    std::shared_ptr<boost::asio::thread_pool> tick_pool_;
+    unsigned tick_threads_ = 1;
 };
 
 }  // namespace model
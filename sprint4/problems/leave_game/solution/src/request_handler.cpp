@@ -1,7 +1,20 @@
 #include "request_handler.h"
-#include "loottypes.h"
+#include <charconv>
 
 namespace http_handler {
+namespace {
+// 64-bit FNV-1a, used for entity tags
+std::uint64_t Fnv1a(std::string_view data) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char ch : data)
+    {
+        hash ^= ch;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+}  // namespace
+
     RequestHandler::StringResponse RequestHandler::MakeStringResponse(http::status status, std::string_view body, int x, unsigned http_version,
         bool keep_alive,
         std::string_view content_type) const
@@ -242,9 +255,9 @@ namespace http_handler {
         //                                                   ,                        : Hello
     }
 
-    RequestHandler::StringResponse RequestHandler::HandleApiRequest(StringRequest&& req, const model::Game& gm) const
+    RequestHandler::StringResponse RequestHandler::HandleApiRequest(StringRequest&& req) const
     {
-        return api_handler_.HandleRequest(std::forward<decltype(req)>(req), gm);
+        return api_handler_.HandleRequest(std::forward<decltype(req)>(req));
     }
 
     bool ApiHandler::IsApiRequest(StringRequest request) const
@@ -323,13 +336,58 @@ namespace http_handler {
         builder.Value(CollectBuildings(m)).Key(OFFICES);
         builder.Value(CollectOffices(m));
 
-        std::ostringstream strm; strm << loot_types::to_frontend_loot_type_data[*(m->GetId())];
         auto maps_parsed = json::Print(builder.EndDict().Build());
-        auto maps_to_string = maps_parsed.substr(0, maps_parsed.size() - 1) + "," + LOOT_TYPES + ":" + strm.str() + "}";
+        auto maps_to_string = maps_parsed.substr(0, maps_parsed.size() - 1) + "," + LOOT_TYPES + ":" + m->GetLootTypesJson() + "}";
 
         return maps_to_string;
     }
 
+    ApiHandler::RenderedBody ApiHandler::MakeRenderedBody(std::string body)
+    {
+        std::ostringstream etag;
+        etag << '"' << std::hex << std::setw(16) << std::setfill('0') << Fnv1a(body) << '"';
+        return RenderedBody{ std::make_shared<const std::string>(std::move(body)), etag.str() };
+    }
+
+    void ApiHandler::RenderMaps()
+    {
+        json::Builder list_builder;
+        maps_list_ = MakeRenderedBody(GetMaps(list_builder, game_));
+        for (const auto& m : game_.GetMaps())
+        {
+            json::Builder builder;
+            map_descriptions_.emplace(*m.GetId(), MakeRenderedBody(GetMapWithSpecificId(builder, &m)));
+        }
+    }
+
+    bool ApiHandler::EtagMatches(std::string_view if_none_match, std::string_view etag)
+    {
+        // comma separated list of tags, If-None-Match compares them weakly
+        while (!if_none_match.empty())
+        {
+            const auto comma = if_none_match.find(',');
+            auto tag = if_none_match.substr(0, comma);
+            if_none_match.remove_prefix(comma == std::string_view::npos ? if_none_match.size() : comma + 1);
+            while (!tag.empty() && tag.front() == ' ')
+            {
+                tag.remove_prefix(1);
+            }
+            while (!tag.empty() && tag.back() == ' ')
+            {
+                tag.remove_suffix(1);
+            }
+            if (tag.substr(0, 2) == "W/")
+            {
+                tag.remove_prefix(2);
+            }
+            if (tag == "*" || tag == etag)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     std::string ApiHandler::BadRequest() const
     {
         boost::property_tree::ptree pt;
@@ -386,50 +444,130 @@ namespace http_handler {
         return json::Print(builder.EndDict().Build());
     }
 
-    std::string ApiHandler::GetPlayers(json::Builder& builder, const std::vector<model::Dog>& dogs) const
+    std::string ApiHandler::GetPlayers(json::Builder& builder, const model::DogStorage& dogs) const
     {
         builder.StartDict();
-        for (const auto& dog : dogs)
+        for (size_t slot = 0; slot < dogs.Size(); slot++)
         {
+            const auto& info = dogs.Info(slot);
             json::Builder helpbuilder;
-            builder.Key(std::to_string(dog.GetId())).Value(helpbuilder.StartDict().Key(NAME).Value(dog.GetName()).EndDict().Build().AsMap());
+            builder.Key(std::to_string(info.id)).Value(helpbuilder.StartDict().Key(NAME).Value(info.name).EndDict().Build().AsMap());
         }
         return json::Print(builder.EndDict().Build());
     }
 
-    std::string ApiHandler::GameState(json::Builder& builder, const std::vector<model::Dog>& dogs, const std::unordered_map<std::uint64_t, model::LostObject>& lost_objects) const
+    std::string ApiHandler::GameState(json::Builder& builder, const model::GameSession& session, std::uint64_t dog_id, std::optional<std::uint64_t> since) const
     {
-        builder.StartDict().Key(PLAYERS);
-        json::Builder helper;
-        helper.StartDict();
-        for (const auto& dog : dogs)
+        const auto& dogs = session.GetDogs();
+        const auto& lost_objects = session.GetLostObjects();
+        std::vector<size_t> dog_slots;
+        std::vector<std::uint64_t> lost_object_ids;
+        json::Array removed_dogs;
+        json::Array removed_lost_objects;
+        const double radius = session.GetMap().GetViewRadius();
+        // deltas do not track what enters or leaves the view, filtered maps always get a full state
+        std::optional<model::TickChanges> changes;
+        if (since && radius <= 0)
         {
-            json::Builder helpbuilder;
-            auto ps = dog.GetPos();
-            auto spd = dog.GetSpd();
-            json::Array pos{ json::Node(ps.x), json::Node(ps.y) };
-            json::Array speed{ json::Node(spd.vx), json::Node(spd.vy) };
-            json::Array bag{};
-            for (const auto& item : dog.GetBag())
+            changes = session.CollectChanges(*since);
+        }
+        if (changes)
+        {
+            // changed ids may have been removed later on and removed ones are never reused
+            for (const auto id : changes->dogs)
+            {
+                if (auto slot = dogs.FindSlot(id))
+                {
+                    dog_slots.push_back(*slot);
+                }
+            }
+            std::sort(dog_slots.begin(), dog_slots.end());
+            for (const auto id : changes->removed_dogs)
+            {
+                if (!dogs.FindSlot(id))
+                {
+                    removed_dogs.push_back(json::Node(static_cast<int>(id)));
+                }
+            }
+            for (const auto id : changes->lost_objects)
             {
-                json::Builder help_build_bag;
-                help_build_bag.StartDict().Key(ID).Value(static_cast<int>(item.GetId())).Key(TYPE).Value(item.GetType());
-                bag.push_back(json::Node{ help_build_bag.EndDict().Build().AsMap() });
+                if (lost_objects.contains(id))
+                {
+                    lost_object_ids.push_back(id);
+                }
+            }
+            for (const auto id : changes->removed_lost_objects)
+            {
+                if (!lost_objects.contains(id))
+                {
+                    removed_lost_objects.push_back(json::Node(static_cast<int>(id)));
+                }
             }
-            helper.Key(std::to_string(dog.GetId())).Value(helpbuilder.StartDict().Key(NAME).Value(dog.GetName()).Key(POS).Value(pos).Key(SPEED).Value(speed).Key(DIR).Value(dog.GetDir()).Key(BAG).Value(bag).Key(SCORE).Value(static_cast<int>(dog.GetScore())).EndDict().Build().AsMap());
         }
-        builder.Value(helper.EndDict().Build().AsMap());
-        json::Builder build_lost_objects;
-        build_lost_objects.StartDict();
-        for (auto it = lost_objects.begin(); it!=lost_objects.end(); it++)
+        else if (radius > 0)
         {
-            json::Array point_info = json::Array{json::Node((it->second).GetX()), json::Node((it->second).GetY())};
-            json::Builder helpbuilder;
-            helpbuilder.StartDict();
-            helpbuilder.Key(TYPE).Value((it->second).GetType()).Key(POS).Value(point_info);
-            build_lost_objects.Key(std::to_string((it->second).GetId())).Value(helpbuilder.EndDict().Build().AsMap());
+            // the handler answers PlayerNotFound for a dog missing from the session, it sees nothing here
+            if (auto slot = dogs.FindSlot(dog_id))
+            {
+                session.CollectVisible(dogs.Positions()[*slot], radius, dog_slots, lost_object_ids);
+            }
+        }
+        else
+        {
+            dog_slots.reserve(dogs.Size());
+            for (size_t slot = 0; slot < dogs.Size(); slot++)
+            {
+                dog_slots.push_back(slot);
+            }
+            lost_object_ids.reserve(lost_objects.size());
+            for (const auto& [id, obj] : lost_objects)
+            {
+                lost_object_ids.push_back(id);
+            }
+        }
+
+        builder.StartDict();
+        if (since)
+        {
+            builder.Key(TICK).Value(static_cast<int>(session.GetTick())).Key(FULL).Value(!changes);
+        }
+        // dictionaries are filled in place and moved into the result, no builder per dog or item
+        json::Dict players;
+        for (const auto slot : dog_slots)
+        {
+            const auto& info = dogs.Info(slot);
+            const auto& ps = dogs.Positions()[slot];
+            const auto& spd = dogs.Speeds()[slot];
+            const auto dog_bag = dogs.Bag(slot);
+            json::Array bag;
+            bag.reserve(dog_bag.size());
+            for (const auto& item : dog_bag)
+            {
+                bag.emplace_back(json::Dict{ { ID, json::Node(static_cast<int>(item.id)) }, { TYPE, json::Node(item.type) } });
+            }
+            json::Dict dog{
+                { NAME, json::Node(info.name) },
+                { POS, json::Node(json::Array{ json::Node(ps.x), json::Node(ps.y) }) },
+                { SPEED, json::Node(json::Array{ json::Node(spd.vx), json::Node(spd.vy) }) },
+                { DIR, json::Node(std::string(model::DirectionToString(dogs.Directions()[slot]))) },
+                { SCORE, json::Node(static_cast<int>(info.score)) } };
+            dog.emplace(BAG, json::Node(std::move(bag)));
+            players.emplace(std::to_string(info.id), json::Node(std::move(dog)));
+        }
+        builder.Key(PLAYERS).Value(std::move(players));
+        json::Dict build_lost_objects;
+        for (const auto id : lost_object_ids)
+        {
+            const auto& obj = lost_objects.at(id);
+            build_lost_objects.emplace(std::to_string(obj.GetId()), json::Node(json::Dict{
+                { TYPE, json::Node(obj.GetType()) },
+                { POS, json::Node(json::Array{ json::Node(obj.GetX()), json::Node(obj.GetY()) }) } }));
+        }
+        builder.Key(LOST_OBJECTS).Value(std::move(build_lost_objects));
+        if (changes)
+        {
+            builder.Key(REMOVED_PLAYERS).Value(removed_dogs).Key(REMOVED_LOST_OBJECTS).Value(removed_lost_objects);
         }
-        builder.Key(LOST_OBJECTS).Value(build_lost_objects.EndDict().Build().AsMap());
         return json::Print(builder.EndDict().Build());
     }
     
@@ -495,7 +633,7 @@ namespace http_handler {
         return false;
     }
 
-    ApiHandler::StringResponse ApiHandler::HandleRequest(StringRequest&& req, const model::Game& gm) {
+    ApiHandler::StringResponse ApiHandler::HandleRequest(StringRequest&& req) {
         const auto text_response = [&req, this](http::status status, std::string_view text, int x) {
             return this->MakeStringResponse(status, text, x, req.version(), req.keep_alive());
             };
@@ -509,16 +647,31 @@ namespace http_handler {
             return this->MakeStringInvalidCacheResponse(status, text, x, req.version(), req.keep_alive(), allowed, cache);
             };
 
+        // 304 without a body if the client already has this version, the stored body otherwise
+        const auto rendered_response = [&req, this](const RenderedBody& rendered) {
+            const auto if_none_match = req[http::field::if_none_match];
+            const bool not_modified = !if_none_match.empty() && EtagMatches(if_none_match, rendered.etag);
+            const std::string_view body = not_modified ? std::string_view{} : std::string_view{ *rendered.body };
+            auto response = this->MakeStringCacheResponse(not_modified ? http::status::not_modified : http::status::ok, body, body.size(), req.version(), req.keep_alive(), Cache::NO_CACHE);
+            response.set(http::field::etag, rendered.etag);
+            return response;
+            };
+
         json::Builder builder;
 
         auto str_form = urlDecode(static_cast<std::string>(req.target()));
         //url-decode str
+        std::string query;
+        if (auto query_start = str_form.find('?'); query_start != std::string::npos)
+        {
+            query = str_form.substr(query_start + 1);
+            str_form.resize(query_start);
+        }
         if (str_form == MAPS_PATH_WITH_SLASH || str_form == MAPS_PATH_WITHOUT_SLASH)
         {
             if (req.method() == http::verb::get)
             {
-                auto result = GetMaps(builder, gm);
-                return text_cache_response(http::status::ok, result, result.size(), Cache::NO_CACHE);
+                return rendered_response(maps_list_);
             }
 
             auto result = InvalidMethod(builder, GET);
@@ -533,10 +686,9 @@ namespace http_handler {
                 {
                     id = id.substr(0, id.size() - 1);
                 }
-                if (auto m = gm.FindMap(model::Map::Id(id)))
+                if (auto it = map_descriptions_.find(id); it != map_descriptions_.end())
                 {
-                    auto result = GetMapWithSpecificId(builder, m);
-                    return text_cache_response(http::status::ok, result, result.size(), Cache::NO_CACHE);
+                    return rendered_response(it->second);
                 }
 
                 auto result = MapNotFound(builder);
@@ -568,12 +720,12 @@ namespace http_handler {
                         auto result = MapNotFound(builder);
                         return text_cache_response(http::status::not_found, result, result.size(), Cache::NO_CACHE);
                     }
-                    auto rp = search->GetRandomPosition(randomize_spawn_points_);
+                    std::shared_ptr<model::GameSession> session = sm_.JoinSession(search);
+                    auto rp = session->GetSpawnPosition(randomize_spawn_points_);
                     model::Dog dog(user_name, rp.second, rp.first);
-                    std::shared_ptr<model::GameSession> session = sm_.FindSession(search, 0);
                     session->AddDog(dog);
-                    auto& player = players_.Addplayer(dog, session);
-                    auto result = AuthRequest(builder, *player.GetAuthToken(), player.GetDog().GetId());
+                    auto& player = players_.Addplayer(dog.GetId(), session);
+                    auto result = AuthRequest(builder, *player.GetAuthToken(), player.GetDogId());
                     return text_cache_response(http::status::ok, result, result.size(), Cache::NO_CACHE);
                 }
                 catch (const boost::system::system_error& ex) // failed json parse
@@ -614,7 +766,7 @@ namespace http_handler {
                 }
                 try {
                     app::Token tagged_token{ auth_token };
-                    auto player = players_.FindByToken(tagged_token);
+                    const auto& player = players_.FindByToken(tagged_token);
                     auto result = GetPlayers(builder, player.GetSession().GetDogs());
                     return text_cache_response(http::status::ok, result, result.size(), Cache::NO_CACHE);
                 }
@@ -656,9 +808,32 @@ namespace http_handler {
                 }
                 try {
                     app::Token tagged_token{ auth_token };
-                    auto player = players_.FindByToken(tagged_token);
-                    auto session = player.GetSession();    
-                    auto result = GameState(builder, session.GetDogs(), session.GetLostObjects());
+                    // served straight from the session, polling must not copy dogs and loot
+                    const auto& player = players_.FindByToken(tagged_token);
+                    const auto& session = player.GetSession();
+                    if (!session.GetDogs().FindSlot(player.GetDogId()))
+                    {
+                        auto result = PlayerNotFound(builder);
+                        return text_cache_response(http::status::unauthorized, result, result.size(), Cache::NO_CACHE);
+                    }
+                    auto since = ParseSince(query);
+                    if (!since && !query.empty())
+                    {
+                        auto result = BadRequest(INVALID_ARGUEMENT, INVALID_SINCE);
+                        return text_cache_response(http::status::bad_request, result, result.size(), Cache::NO_CACHE);
+                    }
+                    if (!since && session.GetMap().GetViewRadius() <= 0)
+                    {
+                        // every player of the session gets the same body, it is built once per change
+                        auto state = session.GetCachedState();
+                        if (!state)
+                        {
+                            state = std::make_shared<const std::string>(GameState(builder, session, player.GetDogId(), since));
+                            session.CacheState(state);
+                        }
+                        return text_cache_response(http::status::ok, *state, state->size(), Cache::NO_CACHE);
+                    }
+                    auto result = GameState(builder, session, player.GetDogId(), since);
                     return text_cache_response(http::status::ok, result, result.size(), Cache::NO_CACHE);
                 }
                 catch (const std::logic_error& ex)
@@ -699,7 +874,7 @@ namespace http_handler {
                 }
                 try {
                     app::Token tagged_token{ auth_token };
-                    auto player = players_.FindByToken(tagged_token);
+                    auto& player = players_.FindByToken(tagged_token);
                     try {
                         std::string content_type = "";
                         for (auto& field : req.base())
@@ -770,8 +945,7 @@ namespace http_handler {
                     auto req_body = req.body();
                     auto value = js::parse(req_body).as_object();
                     auto time = value.at(TIME_DELTA).as_int64();
-                    sm_.UpdateAllSessions(time, lg_);
-                    players_.SyncronizeSession();
+                    sm_.UpdateAllSessions(time);
                     TrySaveRecordsAndRetirePlayers();
                     listener_->OnTick(time, sm_, players_);
                     auto result = MoveRequestOrTimeTickRequest(builder);
@@ -844,6 +1018,21 @@ namespace http_handler {
         //                                                   ,                        : Hello
     }
     
+    std::optional<std::uint64_t> ApiHandler::ParseSince(std::string_view query) const {
+        if (query.substr(0, SINCE_PARAM.size()) != SINCE_PARAM)
+        {
+            return std::nullopt;
+        }
+        query.remove_prefix(SINCE_PARAM.size());
+        std::uint64_t tick = 0;
+        auto [end, ec] = std::from_chars(query.data(), query.data() + query.size(), tick);
+        if (ec != std::errc{} || end != query.data() + query.size())
+        {
+            return std::nullopt;
+        }
+        return tick;
+    }
+
     std::string ApiHandler::ScoresRequest(json::Builder& builder, const std::vector<PlayerAndScore>& scores) {
         builder.StartDict();
         for (const auto& line : scores)
@@ -854,9 +1043,21 @@ namespace http_handler {
     }
 
     void ApiHandler::TrySaveRecordsAndRetirePlayers() {
+        std::vector<model::Dog> retired;
+        for (const auto& session : sm_.GetAllSessions())
+        {
+            auto dogs = session->TakeRetiredDogs();
+            retired.insert(retired.end(), std::make_move_iterator(dogs.begin()), std::make_move_iterator(dogs.end()));
+        }
+        // most ticks retire nobody, they should not cost a connection and a transaction
+        if (retired.empty())
+        {
+            return;
+        }
+        players_.EraseRetiredPlayers(retired);
         auto conn = cp_.GetConnection();
         pqxx::work w{ *conn };
-        for (auto erased_dog : players_.EraseRetiredPlayers(game_.GetRetTime()))
+        for (const auto& erased_dog : retired)
         {
             w.exec_prepared("insert_player", erased_dog.GetName(), erased_dog.GetScore(), erased_dog.GetTime());
         }
@@ -864,8 +1065,7 @@ namespace http_handler {
     }
 
     void ApiHandler::Tick(std::uint64_t time) {
-        sm_.UpdateAllSessions(time, lg_);
-        players_.SyncronizeSession();
+        sm_.UpdateAllSessions(time);
         TrySaveRecordsAndRetirePlayers();
         listener_->OnTick(time, sm_, players_);
     }
@@ -118,6 +118,12 @@ namespace http_handler {
 
         const std::string GAME_STATE_WITHOUT_SLASH = "/api/v1/game/state";
         const std::string GAME_STATE_WITH_SLASH = "/api/v1/game/state/";
+        const std::string SINCE_PARAM = "since=";
+        const std::string INVALID_SINCE = "Invalid since parameter";
+        const std::string TICK = "tick";
+        const std::string FULL = "full";
+        const std::string REMOVED_PLAYERS = "removedPlayers";
+        const std::string REMOVED_LOST_OBJECTS = "removedLostObjects";
 
         const std::string MAP_ID = "mapId";
         const std::string USER_NAME = "userName";
@@ -182,8 +188,9 @@ namespace http_handler {
         };
 
     public:
-        explicit ApiHandler(model::Game& game, app::Players& players, model::SessionManager& sm, std::uint64_t tick_period, bool randomize_spawn_points, loot_gen::LootGenerator lg, app::ApplicationListener& listener, ConnectionPool& cp)
-            : game_{ game }, players_(players), sm_(sm), tick_period_(tick_period), randomize_spawn_points_(randomize_spawn_points), lg_(lg), listener_(&listener), cp_(cp) {
+        explicit ApiHandler(model::Game& game, app::Players& players, model::SessionManager& sm, std::uint64_t tick_period, bool randomize_spawn_points, app::ApplicationListener& listener, ConnectionPool& cp)
+            : game_{ game }, players_(players), sm_(sm), tick_period_(tick_period), randomize_spawn_points_(randomize_spawn_points), listener_(&listener), cp_(cp) {
+            RenderMaps();
         }
 
         bool IsApiRequest(StringRequest request) const;
@@ -212,7 +219,7 @@ namespace http_handler {
         json::Array CollectBuildings(const model::Map* m) const;
         json::Array CollectOffices(const model::Map* m) const;
 
-        StringResponse HandleRequest(StringRequest&& request, const model::Game& gm);
+        StringResponse HandleRequest(StringRequest&& request);
 
         std::string urlDecode(const std::string& SRC) const;
 
@@ -222,22 +229,39 @@ namespace http_handler {
         bool IsValid(const std::string& auth_token) const;
         std::string AuthFailed(json::Builder& builder) const;
         std::string PlayerNotFound(json::Builder& builder) const;
-        std::string GetPlayers(json::Builder& builder, const std::vector<model::Dog>& dogs) const;
-        std::string GameState(json::Builder& builder, const std::vector<model::Dog>& dogs, const std::unordered_map<std::uint64_t, model::LostObject>& lost_objects) const;
+        std::string GetPlayers(json::Builder& builder, const model::DogStorage& dogs) const;
+        // Everything in the session, or only what is within the map view radius of the player's dog.
+        // With since it also reports the session tick and, if the history reaches back that far,
+        // only what changed after that tick plus the ids removed meanwhile.
+        std::string GameState(json::Builder& builder, const model::GameSession& session, std::uint64_t dog_id, std::optional<std::uint64_t> since) const;
+        // Tick of a "since=<tick>" query, nullopt for any other query
+        std::optional<std::uint64_t> ParseSince(std::string_view query) const;
         std::string MoveRequestOrTimeTickRequest(json::Builder& builder) const;
         std::string ScoresRequest(json::Builder& builder, const std::vector<PlayerAndScore>& scores);
         void Tick(std::uint64_t time);
         void TrySaveRecordsAndRetirePlayers();
 
     private:
+        // Immutable response body with its strong entity tag
+        struct RenderedBody {
+            std::shared_ptr<const std::string> body;
+            std::string etag;
+        };
+        // Maps do not change after loading, their descriptions are rendered once
+        void RenderMaps();
+        static RenderedBody MakeRenderedBody(std::string body);
+        // true if the If-None-Match value lists etag or is "*"
+        static bool EtagMatches(std::string_view if_none_match, std::string_view etag);
+
         model::Game& game_;
         app::Players& players_;
         model::SessionManager& sm_;
         std::uint64_t tick_period_;
         bool randomize_spawn_points_;
-        loot_gen::LootGenerator lg_;
         app::ApplicationListener* listener_;
         ConnectionPool& cp_;
+        RenderedBody maps_list_;
+        std::unordered_map<std::string, RenderedBody> map_descriptions_;
     };
 
     class RequestHandler : public std::enable_shared_from_this<RequestHandler> {
@@ -321,7 +345,7 @@ namespace http_handler {
                         assert(self->api_strand_.running_in_this_thread());
                         int time;
                         DurationMeasure* dm = new DurationMeasure(time);
-                        StringResponse response = self->HandleApiRequest(const_cast<http::request<Body, http::basic_fields<Allocator>> && >(req), self->game_);
+                        StringResponse response = self->HandleApiRequest(const_cast<http::request<Body, http::basic_fields<Allocator>> && >(req));
                         dm->~DurationMeasure();
                         std::string CT;
                         for (auto& field : response.base())
@@ -398,7 +422,7 @@ namespace http_handler {
         std::string BadRequest() const;
         std::string FileNotFound(json::Builder& builder) const;
         std::variant<RequestHandler::StringResponse, RequestHandler::FileResponse> HandleRequest(StringRequest&& req, const model::Game& gm) const;
-        RequestHandler::StringResponse HandleApiRequest(StringRequest&& req, const model::Game& gm) const;
+        RequestHandler::StringResponse HandleApiRequest(StringRequest&& req) const;
         std::string DetectContentType(const std::string& ext) const;
         bool IsSubPath(fs::path path, fs::path base) const;
         std::string urlDecode(const std::string& SRC) const;
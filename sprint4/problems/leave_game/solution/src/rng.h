@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace rng {
+
+// Advances state and returns the next splitmix64 output, used to derive independent seeds
+inline std::uint64_t SplitMix64(std::uint64_t& state) noexcept {
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256** by Blackman and Vigna: small, fast and good enough for game logic.
+// Meets UniformRandomBitGenerator, so it works with the <random> distributions.
+class Xoshiro256 {
+public:
+    using result_type = std::uint64_t;
+
+    explicit Xoshiro256(std::uint64_t seed = 0) noexcept {
+        for (auto& s : state_)
+        {
+            s = SplitMix64(seed);
+        }
+    }
+
+    static constexpr result_type min() noexcept { return 0; }
+    static constexpr result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() noexcept {
+        const result_type result = Rotl(state_[1] * 5, 7) * 9;
+        const result_type t = state_[1] << 17;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= t;
+        state_[3] = Rotl(state_[3], 45);
+        return result;
+    }
+
+private:
+    static constexpr result_type Rotl(result_type x, int k) noexcept {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    std::array<result_type, 4> state_;
+};
+
+}  // namespace rng
@@ -0,0 +1,127 @@
+#include "timer_wheel.h"
+
+#include <bit>
+
+namespace timer_wheel {
+
+void TimerWheel::Schedule(Id id, Time deadline) {
+    deadlines_[id] = deadline;
+    Place(Entry{ id, deadline });
+}
+
+void TimerWheel::Cancel(Id id) {
+    deadlines_.erase(id);
+}
+
+void TimerWheel::Place(const Entry& entry) {
+    if (entry.deadline <= now_)
+    {
+        due_.push_back(entry);
+        return;
+    }
+    // the lowest level whose enclosing block still contains both now_ and the deadline
+    for (int level = 0; level < LEVELS; ++level)
+    {
+        const int shift = LEVEL_BITS * (level + 1);
+        if ((entry.deadline >> shift) == (now_ >> shift))
+        {
+            const auto idx = (entry.deadline >> (LEVEL_BITS * level)) & (SLOTS - 1);
+            levels_[level][idx].push_back(entry);
+            occupied_[level] |= std::uint64_t{ 1 } << idx;
+            return;
+        }
+    }
+    overflow_.push_back(entry);
+}
+
+TimerWheel::Time TimerWheel::NextEventTime() const {
+    // slots of a level only ever hold timers ahead of its current index, and any of them
+    // comes before the next slot of the level above
+    for (int level = 0; level < LEVELS; ++level)
+    {
+        const int shift = LEVEL_BITS * level;
+        const auto current = (now_ >> shift) & (SLOTS - 1);
+        const std::uint64_t ahead = current + 1 < SLOTS ? occupied_[level] & (~std::uint64_t{ 0 } << (current + 1)) : 0;
+        if (ahead)
+        {
+            const Time block_start = (now_ >> (shift + LEVEL_BITS)) << (shift + LEVEL_BITS);
+            return block_start + (static_cast<Time>(std::countr_zero(ahead)) << shift);
+        }
+    }
+    const int shift = LEVEL_BITS * LEVELS;
+    return ((now_ >> shift) + 1) << shift;
+}
+
+void TimerWheel::Cascade(int level) {
+    Slot entries;
+    if (level == LEVELS)
+    {
+        entries.swap(overflow_);
+    }
+    else
+    {
+        const auto idx = (now_ >> (LEVEL_BITS * level)) & (SLOTS - 1);
+        entries.swap(levels_[level][idx]);
+        occupied_[level] &= ~(std::uint64_t{ 1 } << idx);
+    }
+    for (const auto& entry : entries)
+    {
+        Place(entry);
+    }
+}
+
+void TimerWheel::Expire(Slot& slot, std::vector<Id>& expired) {
+    for (const auto& entry : slot)
+    {
+        if (auto it = deadlines_.find(entry.id); it != deadlines_.end() && it->second == entry.deadline)
+        {
+            deadlines_.erase(it);
+            expired.push_back(entry.id);
+        }
+    }
+    slot.clear();
+}
+
+void TimerWheel::Advance(Time now, std::vector<Id>& expired) {
+    Expire(due_, expired);
+    while (now_ < now)
+    {
+        if (deadlines_.empty())
+        {
+            // only stale entries are left, drop them instead of walking through them
+            for (int level = 0; level < LEVELS; ++level)
+            {
+                for (; occupied_[level]; occupied_[level] &= occupied_[level] - 1)
+                {
+                    levels_[level][std::countr_zero(occupied_[level])].clear();
+                }
+            }
+            overflow_.clear();
+            now_ = now;
+            break;
+        }
+        const Time next = NextEventTime();
+        if (next > now)
+        {
+            now_ = now;
+            break;
+        }
+        now_ = next;
+        // entering a new block of a level: spread its timers over the levels below, highest first
+        int top = 0;
+        while (top < LEVELS && (now_ & ((Time{ 1 } << (LEVEL_BITS * (top + 1))) - 1)) == 0)
+        {
+            ++top;
+        }
+        for (int level = top; level >= 1; --level)
+        {
+            Cascade(level);
+        }
+        const auto idx = now_ & (SLOTS - 1);
+        occupied_[0] &= ~(std::uint64_t{ 1 } << idx);
+        Expire(due_, expired);
+        Expire(levels_[0][idx], expired);
+    }
+}
+
+}  // namespace timer_wheel
@@ -0,0 +1,53 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace timer_wheel {
+
+// Hierarchical timer wheel with millisecond resolution.
+// Scheduling and cancelling are O(1). Advancing jumps straight to the next occupied slot,
+// so its cost depends on the timers that cascade or expire rather than on the elapsed time.
+class TimerWheel {
+public:
+    using Id = std::uint64_t;
+    using Time = std::uint64_t;
+
+    explicit TimerWheel(Time now = 0) : now_(now) {}
+
+    // Replaces the previous deadline of id, if any. A deadline not after Now() expires on the next Advance.
+    void Schedule(Id id, Time deadline);
+    void Cancel(Id id);
+    bool IsScheduled(Id id) const { return deadlines_.contains(id); }
+    Time Now() const { return now_; }
+    // Moves the wheel to now and appends ids whose deadline has come to expired, earliest first
+    void Advance(Time now, std::vector<Id>& expired);
+
+private:
+    static constexpr int LEVEL_BITS = 6;
+    static constexpr Time SLOTS = Time{ 1 } << LEVEL_BITS;
+    static constexpr int LEVELS = 4;  // 2^24 ms, about 4.6 hours; later deadlines wait in overflow_
+
+    struct Entry {
+        Id id;
+        Time deadline;
+    };
+    using Slot = std::vector<Entry>;
+
+    void Place(const Entry& entry);
+    // The earliest time after now_ at which some slot has to be processed
+    Time NextEventTime() const;
+    void Cascade(int level);
+    void Expire(Slot& slot, std::vector<Id>& expired);
+
+    Time now_;
+    std::array<std::array<Slot, SLOTS>, LEVELS> levels_;
+    Slot overflow_;
+    Slot due_;
+    std::array<std::uint64_t, LEVELS> occupied_{};  // bit per non-empty slot, stale entries included
+    // current deadline of every scheduled id, entries with another deadline are stale and skipped
+    std::unordered_map<Id, Time> deadlines_;
+};
+
+}  // namespace timer_wheel
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../src/model.h"
+
+#include <cmath>
+#include <random>
+#include <string>
+
+// Square town for benchmarks: roads_per_axis horizontal and as many vertical roads,
+// road_step apart and crossing each other, with one office and no loot types.
+inline model::Map MakeTownMap(const std::string& id, int roads_per_axis, int road_step = 10) {
+	model::Map map(model::Map::Id{ id }, id);
+	const int length = roads_per_axis * road_step;
+	std::uint64_t road_id = 0;
+	for (int i = 0; i < roads_per_axis; ++i)
+	{
+		map.AddRoad(model::Road{ model::Road::HORIZONTAL, model::Point{ 0, i * road_step }, length, id, model::Road::Id{ road_id++ } });
+	}
+	for (int i = 0; i < roads_per_axis; ++i)
+	{
+		map.AddRoad(model::Road{ model::Road::VERTICAL, model::Point{ i * road_step, 0 }, length, id, model::Road::Id{ road_id++ } });
+	}
+	map.AddOffice(model::Office{ model::Office::Id{ "o1" }, model::Point{ 5 * road_step, 5 * road_step }, model::Offset{ 0, 0 } });
+	map.AddSpecificBagCapacity(3);
+	map.CreateRoadGrid();
+	return map;
+}
+
+// Spreads dogs_count dogs over the roads of the session's map, away from the road ends,
+// every dog runs along its road at speed, half of them one way and half the other.
+inline void AddRunningDogs(model::GameSession& session, size_t dogs_count, double speed, unsigned seed = 1) {
+	const auto& roads = session.GetMap().GetRoads();
+	std::mt19937 random(seed);
+	for (size_t i = 0; i < dogs_count; ++i)
+	{
+		const model::Road& road = roads[i % roads.size()];
+		const bool horizontal = road.IsHorizontal();
+		const double length = horizontal ? road.GetEnd().x - road.GetStart().x : road.GetEnd().y - road.GetStart().y;
+		std::uniform_real_distribution<double> along(0.1 * length, 0.9 * length);
+		const double offset = std::round(along(random) * 10) / 10;
+		const model::Position pos = horizontal
+			? model::Position{ road.GetStart().x + offset, static_cast<double>(road.GetStart().y) }
+			: model::Position{ static_cast<double>(road.GetStart().x), road.GetStart().y + offset };
+
+		model::Dog dog("dog", pos, &road);
+		const auto id = dog.GetId();
+		session.AddDog(dog);
+		const bool forward = i % 2 == 0;
+		if (horizontal)
+		{
+			session.SetDogDir(id, forward ? model::Direction::RIGHT : model::Direction::LEFT);
+			session.SetDogSpeed(id, model::Speed{ forward ? speed : -speed, 0.0 });
+		}
+		else
+		{
+			session.SetDogDir(id, forward ? model::Direction::DOWN : model::Direction::UP);
+			session.SetDogSpeed(id, model::Speed{ 0.0, forward ? speed : -speed });
+		}
+	}
+}
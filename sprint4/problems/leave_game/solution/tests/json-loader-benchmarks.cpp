@@ -0,0 +1,36 @@
+#include "../src/json_loader.h"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+namespace {
+
+// City of blocks x blocks square blocks of block_size units, every block side is a road of its own
+boost::json::array MakeCityRoads(int blocks, int block_size) {
+	boost::json::array roads;
+	for (int line = 0; line <= blocks; ++line)
+	{
+		for (int block = 0; block < blocks; ++block)
+		{
+			roads.emplace_back(boost::json::object{ { json_loader::X0, block * block_size },
+				{ json_loader::Y0, line * block_size }, { json_loader::X1, (block + 1) * block_size } });
+			roads.emplace_back(boost::json::object{ { json_loader::X0, line * block_size },
+				{ json_loader::Y0, block * block_size }, { json_loader::Y1, (block + 1) * block_size } });
+		}
+	}
+	return roads;
+}
+
+}  // namespace
+
+// Hidden from the default run, start with: game_server_benchmarks "[benchmark]"
+
+TEST_CASE("Loading a city map", "[.][benchmark]") {
+	// 20200 roads meeting on a lattice of 101 x 101 crossings
+	const auto roads = MakeCityRoads(100, 10);
+
+	BENCHMARK("LoadRoads, 20200 roads") {
+		model::Map map(model::Map::Id{ "city" }, "city");
+		json_loader::LoadRoads(roads, map);
+		return map.GetCrossings().size();
+	};
+}
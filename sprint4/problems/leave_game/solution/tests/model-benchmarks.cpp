@@ -0,0 +1,74 @@
+#include "benchmark-world.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+// Hidden from the default run, start with: game_server_benchmarks "[benchmark]"
+
+TEST_CASE("Movement tick", "[.][benchmark]") {
+	// 20 + 20 crossing roads of 200 units, dogs run slowly enough to stay between the road ends
+	const auto map = MakeTownMap("town", 20);
+	model::GameSession session(&map, 0);
+	AddRunningDogs(session, 10000, 0.1);
+
+	BENCHMARK("10000 running dogs") {
+		session.UpdateSession(50);
+		return session.GetTick();
+	};
+}
+
+TEST_CASE("Mostly idle tick", "[.][benchmark]") {
+	// the same town with one dog in a hundred running, the others stand still waiting for their players;
+	// ticks are cheap enough for Catch to run ~100000 of them, the runners crawl so as not to reach a road end
+	const auto map = MakeTownMap("town", 20);
+	model::GameSession session(&map, 0);
+	AddRunningDogs(session, 10000, 0.001);
+	for (size_t slot = 0; slot < session.GetDogs().Size(); ++slot)
+	{
+		if (slot % 100 != 0)
+		{
+			const auto id = session.GetDogs().Info(slot).id;
+			session.SetDogDir(id, model::Direction::NONE);
+			session.SetDogSpeed(id, model::Speed{ 0.0, 0.0 });
+		}
+	}
+
+	BENCHMARK("10000 dogs, 100 running") {
+		session.UpdateSession(50);
+		return session.GetTick();
+	};
+}
+
+TEST_CASE("Sessions tick scaling", "[.][benchmark]") {
+	// 64 sessions of 1000 dogs each, ticked by UpdateAllSessions on 1 to N threads
+	const auto map = MakeTownMap("town", 20);
+	model::SessionManager sessions(loot_gen::LootGenerator(std::chrono::milliseconds(1000), 0.0), 1, 60000);
+	for (std::uint64_t id = 0; id < 64; ++id)
+	{
+		auto session = std::make_shared<model::GameSession>(&map, id);
+		AddRunningDogs(*session, 1000, 0.1, static_cast<unsigned>(id));
+		sessions.AddSession(session);
+	}
+
+	// powers of two and the core count itself, which need not be one
+	const unsigned max_threads = std::max(std::thread::hardware_concurrency(), 2u);
+	std::vector<unsigned> thread_counts;
+	for (unsigned threads = 1; threads < max_threads; threads *= 2)
+	{
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(max_threads);
+
+	for (const auto threads : thread_counts)
+	{
+		sessions.SetTickThreads(threads);
+		BENCHMARK(std::to_string(threads) + " threads") {
+			sessions.UpdateAllSessions(50);
+		};
+	}
+}
@@ -0,0 +1,70 @@
+#include "benchmark-world.h"
+#include "../src/request_handler.h"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+namespace {
+
+// Ticks are driven by the benchmark, nothing is saved or restored
+class NullListener : public app::ApplicationListener {
+public:
+	void OnTick(std::uint64_t, const model::SessionManager&, const app::Players&) override {}
+	bool Restore(model::SessionManager&, app::Players&, const model::Game&) const override { return false; }
+	void Save(const model::SessionManager&, const app::Players&) const override {}
+};
+
+namespace http = http_handler::http;
+
+http::request<http::string_body> MakeStateRequest(const app::Token& token) {
+	http::request<http::string_body> request{ http::verb::get, "/api/v1/game/state", 11 };
+	request.set(http::field::authorization, "Bearer " + *token);
+	return request;
+}
+
+}  // namespace
+
+// Hidden from the default run, start with: game_server_benchmarks "[benchmark]"
+
+TEST_CASE("Polling the game state", "[.][benchmark]") {
+	// 200 players poll once each between two ticks of a session with 1000 dogs
+	model::Game game;
+	game.AddMap(MakeTownMap("town", 20));
+	const auto& map = game.GetMaps().front();
+	model::SessionManager sessions(loot_gen::LootGenerator(std::chrono::milliseconds(1000), 0.0), 1, 60000);
+	auto session = std::make_shared<model::GameSession>(&map, 0);
+	AddRunningDogs(*session, 1000, 0.1);
+	sessions.AddSession(session);
+
+	app::Players players;
+	std::vector<app::Token> tokens;
+	for (size_t slot = 0; slot < 200; ++slot)
+	{
+		tokens.push_back(players.Addplayer(session->GetDogs().Info(slot).id, session).GetAuthToken());
+	}
+	NullListener listener;
+	ConnectionPool connections(0, [] { return std::shared_ptr<pqxx::connection>{}; });
+	http_handler::ApiHandler api(game, players, sessions, 50, false, listener, connections);
+
+	BENCHMARK("200 polls, state shared until the next tick") {
+		session->CacheState(nullptr);  // the tick that came before
+		size_t bytes = 0;
+		for (const auto& token : tokens)
+		{
+			bytes += api.HandleRequest(MakeStateRequest(token)).body().size();
+		}
+		return bytes;
+	};
+	BENCHMARK("200 polls, state serialized for every poll") {
+		size_t bytes = 0;
+		for (const auto& token : tokens)
+		{
+			session->CacheState(nullptr);
+			bytes += api.HandleRequest(MakeStateRequest(token)).body().size();
+		}
+		return bytes;
+	};
+}